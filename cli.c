@@ -0,0 +1,859 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "cli.h"
+#include "display_diff.h"
+#include "xrandr_apply.h"
+#include "profiles.h"
+#include "daemon.h"
+#include "edid.h"
+#include "providers.h"
+#include "layout.h"
+#include "logical_monitors.h"
+
+/**
+ * @brief Prints the command line help.
+ */
+static void print_usage(FILE *out) {
+    fprintf(out,
+            "Usage: myrandr [command]\n"
+            "\n"
+            "Without a command the interactive TUI is started.\n"
+            "\n"
+            "Commands:\n"
+            "  list                      Show connected displays and their modes\n"
+            "  json                      Same as list, as JSON\n"
+            "  apply [profile]           Apply a saved profile (default: the one for the connected monitors)\n"
+            "  save [profile]            Save the current layout as the profile for the connected monitors\n"
+            "  set OUT [spec...] [OUT [spec...]]...\n"
+            "                            Change one or more outputs in a single xrandr call. Specs:\n"
+            "                              MODE[@RATE]          mode (WIDTHxHEIGHT or a name like 1920x1080i)\n"
+            "                                                   and optional refresh rate\n"
+            "                              +X+Y                 absolute position\n"
+            "                              right-of|left-of|above|below|same-as OUT\n"
+            "                                                   relative position; all of them are\n"
+            "                                                   solved together into absolute ones\n"
+            "                              rotate normal|left|inverted|right\n"
+            "                              reflect normal|x|y|xy\n"
+            "                              scale FACTOR         show FACTOR times the screen area\n"
+            "                                                   (e.g. 1.5 or 0.5)\n"
+            "                              panning WxH | panning off\n"
+            "                                                   scroll over a WxH area of the screen\n"
+            "                              split N              divide the output into N side-by-side\n"
+            "                                                   monitors (RandR 1.5), 1 undoes it\n"
+            "                              primary | auto | off\n"
+            "  primary OUT               Make OUT the primary output\n"
+            "  normalize                 Scale every output to the primary one's DPI (from the\n"
+            "                            physical sizes xrandr reports), keeping them side by side\n"
+            "  wall RxC [bezel X[xY]] [columns-first] OUT...\n"
+            "                            Lay the outputs out as an R by C video wall with the biggest\n"
+            "                            mode they all have, leaving X/Y pixels for the bezels\n"
+            "  monitors                  Show the RandR 1.5 monitors, from xrandr --listmonitors\n"
+            "  setmonitor NAME WxH+X+Y [OUT...]\n"
+            "                            Create the monitor NAME on OUT (none if left out), or resize it\n"
+            "  delmonitor NAME           Delete a monitor made with setmonitor or split\n"
+            "  props OUT [NAME]          Show OUT's properties (or just NAME), e.g. \"Broadcast RGB\"\n"
+            "  providers                 Show the providers (GPUs) and what they can do\n"
+            "  wire [SINK [SOURCE]]      Show SOURCE's images on SINK's outputs and turn on the ones that\n"
+            "                            come up (default: the first unwired GPU and provider 0);\n"
+            "                            SOURCE \"none\" unwires\n"
+            "  offload PROVIDER SINK     Let PROVIDER render for SINK (PRIME offload), \"none\" unwires\n"
+            "  --daemon                  Keep a warm snapshot and serve the commands above over a Unix socket\n"
+            "  help                      Show this help\n"
+            "\n"
+            "If a daemon is running, commands are answered by it instead of querying xrandr.\n");
+}
+
+/**
+ * @brief Writes a string as a JSON string literal.
+ */
+static void write_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/**
+ * @brief Writes the snapshot as a single JSON object.
+ * Mode lists are written as they are, so decode them first with displays_ensure_modes().
+ * @param out Where to write.
+ * @param displays An array of Display structs.
+ * @param count The number of displays in the array.
+ */
+void write_displays_json(FILE *out, const Display *displays, int count) {
+    fprintf(out, "{\"outputs\":[");
+    for (int i = 0; i < count; i++) {
+        const Display *d = &displays[i];
+        fprintf(out, "%s{\"name\":", i ? "," : "");
+        write_json_string(out, d->name);
+        fprintf(out, ",\"connected\":%s,\"active\":%s,\"primary\":%s",
+                d->connected ? "true" : "false", d->is_active ? "true" : "false", d->is_primary ? "true" : "false");
+        if (d->is_active) {
+            fprintf(out, ",\"width\":%d,\"height\":%d,\"x\":%d,\"y\":%d,\"mode\":",
+                    d->width, d->height, d->x_offset, d->y_offset);
+            write_json_string(out, d->mode_name);
+        }
+        if (d->is_active) {
+            fprintf(out, ",\"rotate\":\"%s\",\"reflect\":\"%s\",\"scale\":%.3f", rotation_name(d->rotation),
+                    reflection_name(d->rotation), d->scale);
+        }
+        if (d->panning_width > 0) {
+            fprintf(out, ",\"panning\":{\"width\":%d,\"height\":%d,\"x\":%d,\"y\":%d}", d->panning_width,
+                    d->panning_height, d->panning_x, d->panning_y);
+        }
+        if (d->tile_group != 0) {
+            fprintf(out, ",\"tile\":{\"group\":%d,\"columns\":%d,\"rows\":%d,\"column\":%d,\"row\":%d,"
+                    "\"width\":%d,\"height\":%d,\"leader\":", d->tile_group, d->tile_columns, d->tile_rows,
+                    d->tile_column, d->tile_row, d->tile_width, d->tile_height);
+            write_json_string(out, display_tile_leader(displays, count, d)->name);
+            fputc('}', out);
+        }
+        if (d->width_mm > 0) fprintf(out, ",\"width_mm\":%d,\"height_mm\":%d", d->width_mm, d->height_mm);
+        if (display_dpi(d) > 0.0) fprintf(out, ",\"dpi\":%.1f", display_dpi(d));
+        if (d->crtc >= 0) fprintf(out, ",\"crtc\":%d", d->crtc);
+        if (d->possible_crtcs != 0) {
+            fprintf(out, ",\"possible_crtcs\":[");
+            for (int c = 0, n = 0; c < 32; c++) {
+                if (d->possible_crtcs & ((uint32_t)1 << c)) fprintf(out, "%s%d", n++ ? "," : "", c);
+            }
+            fputc(']', out);
+        }
+        const EdidInfo *edid = display_edid(d);
+        if (edid) {
+            fprintf(out, ",\"monitor\":{\"manufacturer\":");
+            write_json_string(out, edid->manufacturer);
+            fprintf(out, ",\"product\":%u,\"model\":", edid->product_code);
+            write_json_string(out, edid->model);
+            fprintf(out, ",\"serial\":");
+            write_json_string(out, edid->serial_text);
+            fprintf(out, ",\"width_mm\":%d,\"height_mm\":%d,\"identity\":\"%016" PRIx64 "\"}",
+                    edid->width_mm, edid->height_mm, display_identity(d));
+        }
+        fprintf(out, ",\"modes\":[");
+        for (int j = 0; j < d->mode_count; j++) {
+            const Mode *m = &d->modes[j];
+            fprintf(out, "%s{\"name\":", j ? "," : "");
+            write_json_string(out, m->name);
+            fprintf(out, ",\"width\":%d,\"height\":%d,\"interlaced\":%s,\"doublescan\":%s,\"rates\":[",
+                    m->width, m->height, m->interlaced ? "true" : "false", m->doublescan ? "true" : "false");
+            for (int k = 0; k < m->rate_count; k++) {
+                const RefreshRate *r = &m->refresh_rates[k];
+                fprintf(out, "%s{\"rate\":%.2f,\"current\":%s,\"preferred\":%s", k ? "," : "", r->rate,
+                        r->is_current ? "true" : "false", r->is_preferred ? "true" : "false");
+                if (r->has_timing) {
+                    fprintf(out, ",\"id\":\"0x%lx\",\"pixel_clock\":%.3f,\"h_total\":%d,\"v_total\":%d,\"flags\":",
+                            r->timing.id, r->timing.pixel_clock, r->timing.h_total, r->timing.v_total);
+                    write_json_string(out, r->timing.flags);
+                    if (r->timing.rate_den != 0) {
+                        fprintf(out, ",\"rate_exact\":\"%" PRIu64 "/%" PRIu64 "\"", r->timing.rate_num, r->timing.rate_den);
+                    }
+                }
+                fputc('}', out);
+            }
+            fprintf(out, "]}");
+        }
+        fprintf(out, "]}");
+    }
+    fprintf(out, "]}\n");
+}
+
+/**
+ * @brief Runs a transaction and reports a failed xrandr call.
+ * Tiled monitors are made to go as one, then layouts that can't work are turned down
+ * here, without running xrandr at all; the others get their CRTCs pinned and the screen sized first.
+ * @return Process exit code.
+ */
+static int apply_transaction(Transaction *t, const Display *displays, int count, const ScreenInfo *screen,
+                             FILE *err) {
+    if (transaction_is_empty(t)) return 0;
+    char reason[256];
+    if (!transaction_follow_tiles(t, displays, count)) return 1;
+    if (!transaction_validate(t, displays, count, screen, reason, sizeof(reason))) {
+        fprintf(err, "%s.\n", reason);
+        return 2;
+    }
+    if (!transaction_assign_crtcs(t, displays, count)) {
+        fprintf(err, "Failed to assign CRTCs\n");
+        return 1;
+    }
+    transaction_plan_screen(t, displays, count, screen);
+    int status = transaction_apply(t);
+    if (status != 0) {
+        fprintf(err, "xrandr failed (status %d)\n", status);
+        return 1;
+    }
+    return 0;
+}
+
+static int cmd_apply(Display *displays, int count, const ScreenInfo *screen, const char *name, FILE *err) {
+    ProfileStore store;
+    if (!profile_store_load(&store, NULL)) {
+        fprintf(err, "Failed to load profiles.\n");
+        return 1;
+    }
+
+    const Profile *profile = name ? profile_store_find_by_name(&store, name)
+                                  : profile_store_find(&store, monitor_set_fingerprint(displays, count));
+    if (profile == NULL) {
+        if (name) fprintf(err, "No profile named '%s'.\n", name);
+        else fprintf(err, "No profile saved for the connected monitors.\n");
+        profile_store_free(&store);
+        return 1;
+    }
+
+    int rc = 0;
+    if (!profile_matches_layout(profile, displays, count)) {
+        Transaction t;
+        transaction_init(&t);
+        rc = profile_to_transaction(profile, displays, count, &t) ? apply_transaction(&t, displays, count, screen, err) : 1;
+        transaction_free(&t);
+    }
+    profile_store_free(&store);
+    return rc;
+}
+
+static int cmd_save(const Display *displays, int count, const char *name, FILE *err) {
+    ProfileStore store;
+    if (!profile_store_load(&store, NULL)) {
+        fprintf(err, "Failed to load profiles.\n");
+        return 1;
+    }
+
+    char fingerprint_name[32];
+    if (name == NULL) {
+        snprintf(fingerprint_name, sizeof(fingerprint_name), "%016" PRIx64, monitor_set_fingerprint(displays, count));
+        name = fingerprint_name;
+    }
+
+    int rc = 0;
+    if (profile_store_put(&store, name, displays, count) == NULL || !profile_store_save(&store)) {
+        fprintf(err, "Failed to save profile '%s'.\n", name);
+        rc = 1;
+    }
+    profile_store_free(&store);
+    return rc;
+}
+
+/**
+ * @brief Applies one "MODE[@RATE]" spec to a change, checking it against the output's modes.
+ * MODE is "WIDTHxHEIGHT" or an exact mode name such as "1920x1080i" or "my-mode".
+ * @return True if the spec was valid for this output.
+ */
+static bool apply_mode_spec(const Display *d, const char *spec, OutputChange *c, FILE *err) {
+    char name[32];
+    double rate = 0.0;
+    const char *at = strrchr(spec, '@');
+    size_t name_len = at ? (size_t)(at - spec) : strlen(spec);
+    if (name_len == 0 || name_len >= sizeof(name)) return false;
+    if (at && sscanf(at + 1, "%lf", &rate) != 1) return false;
+    memcpy(name, spec, name_len);
+    name[name_len] = '\0';
+
+    // Snaps to the closest advertised rate, so "60" finds "59.95".
+    const Mode *mode = NULL;
+    const RefreshRate *best = display_find_rate(d, name, rate, &mode);
+    if (best == NULL) {
+        fprintf(err, "%s has no mode %s.\n", d->name, name);
+        return false;
+    }
+    output_change_set_mode(c, mode, rate > 0.0 ? best : NULL);
+    return true;
+}
+
+/**
+ * @brief Adds the monitors the outputs are split into, from where the transaction leaves them,
+ * so the split goes out together with the mode and position changes it depends on.
+ * @param splits Parts per display, 0 for the ones that aren't split.
+ * @return False if memory ran out.
+ */
+static bool add_splits(Transaction *t, const Display *displays, int count, const int *splits) {
+    bool any = false;
+    for (int i = 0; i < count; i++) any = any || splits[i] > 0;
+    if (!any) return true;
+
+    PlannedOutput planned[count > 0 ? count : 1];
+    int monitor_count;
+    LogicalMonitor *monitors = read_logical_monitors(&monitor_count);
+    bool ok = true;
+    transaction_plan(t, displays, count, planned);
+    for (int i = 0; i < count && ok; i++) {
+        if (splits[i] > 0) ok = logical_monitors_split(t, monitors, monitor_count, displays, count, i, planned, splits[i]);
+    }
+    free(monitors);
+    return ok;
+}
+
+/**
+ * @brief Checks every new panning area against the size its output ends up showing, with the
+ * mode, rotation and scale the same command sets.
+ * @return 0, or 2 after telling why if an area is smaller or its output is dark.
+ */
+static int check_panning(const Transaction *t, const Display *displays, int count, FILE *err) {
+    PlannedOutput planned[count > 0 ? count : 1];
+    transaction_plan(t, displays, count, planned);
+    for (int i = 0; i < t->output_count; i++) {
+        const OutputChange *c = &t->outputs[i];
+        if (!c->set_panning || c->panning_width == 0) continue;
+        int index = -1;
+        for (int j = 0; j < count && index < 0; j++) {
+            if (strcmp(displays[j].name, c->name) == 0) index = j;
+        }
+        if (index < 0) continue;
+        const PlannedOutput *p = &planned[index];
+        if (!p->lit || p->view_width <= 0) {
+            fprintf(err, "%s needs to be on, with a mode of known size, for a panning area.\n", c->name);
+            return 2;
+        }
+        if (c->panning_width < p->view_width || c->panning_height < p->view_height) {
+            fprintf(err, "%s needs a panning area at least as big as its mode (%dx%d).\n", c->name,
+                    p->view_width, p->view_height);
+            return 2;
+        }
+    }
+    return 0;
+}
+
+static bool is_relation(const char *word) {
+    static const char *relations[] = {"right-of", "left-of", "above", "below", "same-as"};
+    for (size_t i = 0; i < sizeof(relations) / sizeof(relations[0]); i++) {
+        if (strcmp(word, relations[i]) == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief "set OUT [spec...] [OUT [spec...]]..." -- everything goes out as one transaction.
+ */
+static int cmd_set(const Display *displays, int count, const ScreenInfo *screen, int argc, char **argv, FILE *err) {
+    DisplayIndex index;
+    if (!display_index_build(&index, displays, count)) return 1;
+
+    Transaction t;
+    transaction_init(&t);
+    Layout layout;
+    layout_init(&layout);
+    const Display *current = NULL;
+    OutputChange *change = NULL;
+    int splits[count > 0 ? count : 1]; // Monitors to split each output into, 0 to leave it
+    memset(splits, 0, sizeof(splits));
+    int rc = 0;
+
+    for (int i = 0; i < argc && rc == 0; i++) {
+        const char *arg = argv[i];
+        int found = display_index_find(&index, arg);
+        int x, y;
+        char extra;
+
+        if (found >= 0) {
+            current = &displays[found];
+            change = transaction_output(&t, current->name);
+            if (change == NULL) rc = 1;
+        } else if (change == NULL) {
+            fprintf(err, "Unknown output '%s'.\n", arg);
+            rc = 2;
+        } else if (strcmp(arg, "off") == 0) {
+            change->off = 1;
+        } else if (strcmp(arg, "auto") == 0) {
+            change->auto_mode = 1;
+        } else if (strcmp(arg, "primary") == 0) {
+            change->primary = 1;
+        } else if (strcmp(arg, "scale") == 0) {
+            char *end = NULL;
+            change->scale = i + 1 < argc ? strtod(argv[++i], &end) : 0.0;
+            if (end == NULL || *end != '\0' || change->scale < 0.125 || change->scale > 8.0) {
+                fprintf(err, "%s needs a scale between 0.125 and 8 after 'scale'.\n", current->name);
+                rc = 2;
+            }
+        } else if (strcmp(arg, "split") == 0) {
+            int parts = i + 1 < argc ? atoi(argv[++i]) : 0;
+            if (parts < 1 || parts > 8) {
+                fprintf(err, "%s needs a number of monitors from 1 to 8 after 'split'.\n", current->name);
+                rc = 2;
+            }
+            splits[current - displays] = parts;
+        } else if (strcmp(arg, "panning") == 0) {
+            const char *size = i + 1 < argc ? argv[++i] : "";
+            change->set_panning = 1;
+            change->panning_width = change->panning_height = 0;
+            // The size is checked against the mode once every spec is in, see check_panning()
+            if (strcmp(size, "off") != 0 &&
+                (sscanf(size, "%dx%d%c", &change->panning_width, &change->panning_height, &extra) != 2 ||
+                 change->panning_width <= 0 || change->panning_height <= 0)) {
+                fprintf(err, "%s needs a panning area WxH (or 'off') after 'panning'.\n", current->name);
+                rc = 2;
+            }
+        } else if (strcmp(arg, "rotate") == 0 || strcmp(arg, "reflect") == 0) {
+            if (!change->set_rotation) change->rotation = current->rotation;
+            bool rotate = strcmp(arg, "rotate") == 0;
+            const char *name = i + 1 < argc ? argv[++i] : "";
+            if (!(rotate ? rotation_from_name(name, &change->rotation) : reflection_from_name(name, &change->rotation))) {
+                fprintf(err, "Invalid %s '%s' for %s.\n", arg, name, current->name);
+                rc = 2;
+            } else if (current->rotations != 0 && (change->rotation & ~current->rotations) != 0) {
+                fprintf(err, "%s can't %s %s.\n", current->name, arg, name);
+                rc = 2;
+            }
+            change->set_rotation = 1;
+        } else if (sscanf(arg, "+%d+%d%c", &x, &y, &extra) == 2) {
+            change->set_position = 1;
+            change->x_offset = x;
+            change->y_offset = y;
+        } else if (is_relation(arg)) {
+            // The target is the next word, not the start of another output's specs
+            if (i + 1 >= argc || display_index_find(&index, argv[i + 1]) < 0) {
+                fprintf(err, "%s needs an output after '%s'.\n", current->name, arg);
+                rc = 2;
+            } else if (!layout_set(&layout, current->name, arg, argv[++i])) {
+                rc = 1;
+            }
+        } else if (!apply_mode_spec(current, arg, change, err)) {
+            fprintf(err, "Invalid setting '%s' for %s.\n", arg, current->name);
+            rc = 2;
+        }
+    }
+
+    // An output named without specs leaves an empty change behind, so count what was asked for
+    bool asked = layout.count > 0;
+    for (int i = 0; i < count; i++) asked = asked || splits[i] > 0;
+    if (rc == 0 && !asked && transaction_is_empty(&t)) {
+        print_usage(err);
+        rc = 2;
+    }
+    if (rc == 0) rc = check_panning(&t, displays, count, err);
+    // All relative placements are solved together into absolute positions
+    char reason[256];
+    if (rc == 0 && layout.count > 0 && !layout_solve(&layout, displays, count, &t, reason, sizeof(reason))) {
+        fprintf(err, "%s.\n", reason);
+        rc = 2;
+    }
+    if (rc == 0 && !add_splits(&t, displays, count, splits)) rc = 1;
+    if (rc == 0) rc = apply_transaction(&t, displays, count, screen, err);
+
+    layout_free(&layout);
+    transaction_free(&t);
+    display_index_free(&index);
+    return rc;
+}
+
+/**
+ * @brief "wall ROWSxCOLUMNS [bezel X[xY]] [columns-first] OUT..." -- a video wall in one transaction.
+ */
+static int cmd_wall(const Display *displays, int count, const ScreenInfo *screen, int argc, char **argv, FILE *err) {
+    GridSpec grid = {0, 0, 0, 0, GRID_ROWS_FIRST};
+    int outputs[count > 0 ? count : 1];
+    int n = 0;
+    char extra;
+    if (argc < 2 || sscanf(argv[0], "%dx%d%c", &grid.rows, &grid.columns, &extra) != 2) {
+        print_usage(err);
+        return 2;
+    }
+    for (int i = 1; i < argc; i++) {
+        int found = -1;
+        for (int j = 0; j < count && found < 0; j++) {
+            if (strcmp(displays[j].name, argv[i]) == 0) found = j;
+        }
+        if (strcmp(argv[i], "columns-first") == 0) {
+            grid.order = GRID_COLUMNS_FIRST;
+        } else if (strcmp(argv[i], "bezel") == 0 && i + 1 < argc) {
+            int matched = sscanf(argv[++i], "%dx%d", &grid.bezel_x, &grid.bezel_y);
+            if (matched == 1) grid.bezel_y = grid.bezel_x;
+            if (matched < 1) {
+                fprintf(err, "Invalid bezel '%s'.\n", argv[i]);
+                return 2;
+            }
+        } else if (found < 0) {
+            fprintf(err, "Unknown output '%s'.\n", argv[i]);
+            return 2;
+        } else {
+            // One output can only fill one spot; a second would leave a hole in the wall
+            for (int k = 0; k < n; k++) {
+                if (outputs[k] == found) {
+                    fprintf(err, "Output '%s' is in the wall twice.\n", argv[i]);
+                    return 2;
+                }
+            }
+            outputs[n++] = found;
+        }
+    }
+
+    Transaction t;
+    transaction_init(&t);
+    CommonMode mode;
+    char reason[256];
+    int rc;
+    if (!layout_grid(&grid, displays, outputs, n, &t, &mode, reason, sizeof(reason))) {
+        fprintf(err, "%s.\n", reason);
+        rc = 2;
+    } else {
+        rc = apply_transaction(&t, displays, count, screen, err);
+    }
+    transaction_free(&t);
+    return rc;
+}
+
+/**
+ * @brief "normalize" -- scales the outputs to the primary one's DPI and keeps them touching.
+ */
+static int cmd_normalize(const Display *displays, int count, const ScreenInfo *screen, FILE *out, FILE *err) {
+    Transaction t;
+    transaction_init(&t);
+    char reason[256];
+    int rc = 0;
+    if (!layout_normalize_dpi(displays, count, &t, reason, sizeof(reason))) {
+        fprintf(err, "%s.\n", reason);
+        rc = 2;
+    }
+    for (int i = 0; i < t.output_count && rc == 0; i++) {
+        const OutputChange *c = &t.outputs[i];
+        for (int j = 0; j < count && c->scale > 0.0; j++) {
+            if (strcmp(displays[j].name, c->name) == 0) {
+                fprintf(out, "%s: %.0f DPI, scale %.3g\n", c->name, display_dpi(&displays[j]), c->scale);
+            }
+        }
+    }
+    if (rc == 0 && t.output_count == 0) fprintf(out, "Already even.\n");
+    else if (rc == 0) rc = apply_transaction(&t, displays, count, screen, err);
+    transaction_free(&t);
+    return rc;
+}
+
+/**
+ * @brief "setmonitor NAME WxH+X+Y [OUT...]" -- creates a RandR 1.5 monitor, or resizes the one
+ * with that name. Its physical size follows from the first output's DPI.
+ */
+static int cmd_setmonitor(const Display *displays, int count, const ScreenInfo *screen, int argc, char **argv,
+                          FILE *err) {
+    LogicalMonitor m;
+    char extra;
+    memset(&m, 0, sizeof(m));
+    if (argc < 2 || sscanf(argv[1], "%dx%d%d%d%c", &m.width, &m.height, &m.x_offset, &m.y_offset, &extra) != 4 ||
+        m.width <= 0 || m.height <= 0) {
+        print_usage(err);
+        return 2;
+    }
+    snprintf(m.name, sizeof(m.name), "%s", argv[0]);
+    size_t len = 0;
+    for (int i = 2; i < argc; i++) {
+        int found = -1;
+        for (int j = 0; j < count && found < 0; j++) {
+            if (displays[j].connected && strcmp(displays[j].name, argv[i]) == 0) found = j;
+        }
+        if (found < 0) {
+            fprintf(err, "Unknown output '%s'.\n", argv[i]);
+            return 2;
+        }
+        len += snprintf(m.outputs + len, sizeof(m.outputs) - len, "%s%s", len ? "," : "", argv[i]);
+        if (len >= sizeof(m.outputs)) {
+            fprintf(err, "Too many outputs for one monitor.\n");
+            return 2;
+        }
+    }
+    logical_monitor_physical_size(displays, count, &m);
+
+    Transaction t;
+    transaction_init(&t);
+    int rc = logical_monitor_set(&t, &m) ? apply_transaction(&t, displays, count, screen, err) : 1;
+    transaction_free(&t);
+    return rc;
+}
+
+/**
+ * @brief "delmonitor NAME" -- deletes a monitor made by hand. The server's own ones (one per
+ * lit output) can't be deleted; they only make way for monitors that take their output.
+ */
+static int cmd_delmonitor(const Display *displays, int count, const ScreenInfo *screen, const char *name,
+                          FILE *err) {
+    int monitor_count;
+    LogicalMonitor *monitors = read_logical_monitors(&monitor_count);
+    const LogicalMonitor *m = logical_monitor_find(monitors, monitor_count, name);
+    int rc = 0;
+    if (m == NULL) {
+        fprintf(err, "No monitor '%s'.\n", name);
+        rc = 2;
+    } else if (m->automatic) {
+        fprintf(err, "%s is the server's monitor for its output and can't be deleted.\n", name);
+        rc = 2;
+    }
+    free(monitors);
+    if (rc != 0) return rc;
+
+    Transaction t;
+    transaction_init(&t);
+    MonitorChange *c = transaction_monitor(&t, name);
+    if (c) c->remove = 1;
+    rc = c ? apply_transaction(&t, displays, count, screen, err) : 1;
+    transaction_free(&t);
+    return rc;
+}
+
+static int cmd_primary(const Display *displays, int count, const ScreenInfo *screen, const char *name, FILE *err) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(displays[i].name, name) != 0) continue;
+        if (displays[i].is_primary) return 0;
+
+        Transaction t;
+        transaction_init(&t);
+        OutputChange *c = transaction_output(&t, name);
+        int rc = 1;
+        if (c) {
+            c->primary = 1;
+            rc = apply_transaction(&t, displays, count, screen, err);
+        }
+        transaction_free(&t);
+        return rc;
+    }
+    fprintf(err, "Unknown output '%s'.\n", name);
+    return 1;
+}
+
+/**
+ * @brief "props OUT [NAME]" -- the only command that needs the property block decoded.
+ */
+static int cmd_props(Display *displays, int count, const char *name, const char *property, FILE *out, FILE *err) {
+    for (int i = 0; i < count; i++) {
+        Display *d = &displays[i];
+        if (strcmp(d->name, name) != 0) continue;
+        if (!display_ensure_properties(d)) return 1;
+
+        bool found = false;
+        for (int j = 0; j < d->property_count; j++) {
+            const OutputProperty *prop = &d->properties[j];
+            if (property && strcmp(prop->name, property) != 0) continue;
+            fprintf(out, "%s: %s\n", prop->name, prop->value);
+            if (prop->details[0] != '\0') {
+                // One detail per line, indented under the value
+                for (const char *p = prop->details; *p; ) {
+                    size_t len = strcspn(p, "\n");
+                    fprintf(out, "    %.*s\n", (int)len, p);
+                    p += len + (p[len] == '\n');
+                }
+            }
+            found = true;
+        }
+        if (!found && property) {
+            fprintf(err, "%s has no property '%s'.\n", name, property);
+            return 1;
+        }
+        return 0;
+    }
+    fprintf(err, "Unknown output '%s'.\n", name);
+    return 1;
+}
+
+/**
+ * @brief Works out the two providers for "wire"/"offload" from what was named.
+ * Anything not named comes from the usual reverse-PRIME setup; "none" (XID 0) unwires.
+ * @return False (with a message) if a provider can't be found.
+ */
+static bool resolve_wiring(const Provider *providers, int count, int argc, char **argv,
+                           unsigned long *provider, unsigned long *peer, FILE *err) {
+    const Provider *sink = NULL, *source = NULL;
+    if (argc == 0) {
+        if (!providers_default_wiring(providers, count, &sink, &source)) {
+            fprintf(err, "No provider left to wire up.\n");
+            return false;
+        }
+    } else if ((sink = provider_find(providers, count, argv[0])) == NULL) {
+        fprintf(err, "Unknown provider '%s'.\n", argv[0]);
+        return false;
+    } else if (argc == 1 && (source = provider_default_source(providers, count, sink)) == NULL) {
+        fprintf(err, "No provider to take images from.\n");
+        return false;
+    } else if (argc > 1 && strcmp(argv[1], "none") != 0 && (source = provider_find(providers, count, argv[1])) == NULL) {
+        fprintf(err, "Unknown provider '%s'.\n", argv[1]);
+        return false;
+    }
+    *provider = sink->id;
+    *peer = source ? source->id : 0;
+    return true;
+}
+
+/**
+ * @brief "wire [SINK [SOURCE]]" and "offload PROVIDER SINK". Wiring an output source
+ * makes the sink's outputs show up, so xrandr is asked again and those get turned on
+ * in a second call -- the first one didn't know about them yet.
+ */
+static int cmd_wire(Display *displays, int count, const ScreenInfo *screen, bool offload,
+                    int argc, char **argv, FILE *out, FILE *err) {
+    int provider_count;
+    Provider *providers = read_providers(&provider_count);
+    unsigned long provider, peer;
+    bool resolved = resolve_wiring(providers, provider_count, argc, argv, &provider, &peer, err);
+    free(providers);
+    if (!resolved) return 1;
+
+    Transaction t;
+    transaction_init(&t);
+    int rc = transaction_provider(&t, provider, offload, peer) ? apply_transaction(&t, displays, count, screen, err) : 1;
+    transaction_free(&t);
+    if (rc != 0 || offload || peer == 0) return rc;
+
+    int wired_count;
+    ScreenInfo wired_screen;
+    Display *wired = parse_xrandr_output(&wired_count, &wired_screen, true);
+    if (wired == NULL) return 1;
+    displays_ensure_modes(wired, wired_count);
+    transaction_init(&t);
+    rc = transaction_light_new_outputs(&t, displays, count, wired, wired_count) < 0 ? 1 :
+         apply_transaction(&t, wired, wired_count, &wired_screen, err);
+    for (int i = 0; rc == 0 && i < t.output_count; i++) {
+        fprintf(out, "Turned on %s.\n", t.outputs[i].name);
+    }
+    transaction_free(&t);
+    free_displays(wired, wired_count);
+    return rc;
+}
+
+/**
+ * @brief Checks whether a word is one of the snapshot commands handled by cli_run().
+ */
+bool cli_is_command(const char *command) {
+    static const char *commands[] = {"list", "json", "apply", "save", "set", "primary", "props",
+                                     "providers", "wire", "offload", "wall", "normalize", "monitors",
+                                     "setmonitor", "delmonitor"};
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        if (strcmp(command, commands[i]) == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Whether a command needs the verbose query: CRTC lists, EDIDs, properties, transforms
+ * or tiles. The rest only look at headers and modes, which the plain query has; the ones that
+ * apply something (primary, setmonitor, delmonitor) go out without CRTC or --fb planning then,
+ * see transaction_assign_crtcs() and transaction_plan_screen().
+ */
+static bool cli_needs_verbose(const char *command) {
+    static const char *plain[] = {"primary", "providers", "monitors", "setmonitor", "delmonitor"};
+    for (size_t i = 0; i < sizeof(plain) / sizeof(plain[0]); i++) {
+        if (strcmp(command, plain[i]) == 0) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Runs one command against an already parsed snapshot.
+ * Shared by the command line and the daemon, which hands in memory streams.
+ * @param displays The current snapshot.
+ * @param count The number of displays in the snapshot.
+ * @param screen The screen's framebuffer limits, for checking layouts before they're applied.
+ * @param argc Number of words in argv.
+ * @param argv The command (argv[0]) and its arguments.
+ * @param out Where normal output goes.
+ * @param err Where errors go.
+ * @return Process exit code (0 ok, 1 failure, 2 usage error).
+ */
+int cli_run(Display *displays, int count, const ScreenInfo *screen, int argc, char **argv, FILE *out, FILE *err) {
+    const char *command = argv[0];
+
+    if (!cli_is_command(command)) {
+        fprintf(err, "Unknown command '%s'.\n\n", command);
+        print_usage(err);
+        return 2;
+    }
+    if ((strcmp(command, "primary") == 0 && argc != 2) ||
+        (strcmp(command, "wire") == 0 && argc > 3) ||
+        (strcmp(command, "offload") == 0 && argc != 3) ||
+        (strcmp(command, "props") == 0 && (argc < 2 || argc > 3)) ||
+        (strcmp(command, "setmonitor") == 0 && argc < 3) ||
+        (strcmp(command, "delmonitor") == 0 && argc != 2)) {
+        print_usage(err);
+        return 2;
+    }
+    // Only these look at mode lists; apply/save/primary get by on the headers.
+    if ((strcmp(command, "list") == 0 || strcmp(command, "json") == 0 || strcmp(command, "set") == 0 ||
+         strcmp(command, "wall") == 0 || strcmp(command, "normalize") == 0) &&
+        !displays_ensure_modes(displays, count)) {
+        return 1;
+    }
+
+    if (strcmp(command, "list") == 0) {
+        fprint_displays(out, displays, count);
+        return 0;
+    } else if (strcmp(command, "json") == 0) {
+        write_displays_json(out, displays, count);
+        return 0;
+    } else if (strcmp(command, "apply") == 0) {
+        return cmd_apply(displays, count, screen, argc > 1 ? argv[1] : NULL, err);
+    } else if (strcmp(command, "save") == 0) {
+        return cmd_save(displays, count, argc > 1 ? argv[1] : NULL, err);
+    } else if (strcmp(command, "set") == 0) {
+        return cmd_set(displays, count, screen, argc - 1, argv + 1, err);
+    } else if (strcmp(command, "normalize") == 0) {
+        return cmd_normalize(displays, count, screen, out, err);
+    } else if (strcmp(command, "wall") == 0) {
+        return cmd_wall(displays, count, screen, argc - 1, argv + 1, err);
+    } else if (strcmp(command, "providers") == 0) {
+        int provider_count;
+        Provider *providers = read_providers(&provider_count);
+        fprint_providers(out, providers, provider_count);
+        free(providers);
+        return 0;
+    } else if (strcmp(command, "monitors") == 0) {
+        int monitor_count;
+        LogicalMonitor *monitors = read_logical_monitors(&monitor_count);
+        fprint_logical_monitors(out, monitors, monitor_count);
+        free(monitors);
+        return 0;
+    } else if (strcmp(command, "setmonitor") == 0) {
+        return cmd_setmonitor(displays, count, screen, argc - 1, argv + 1, err);
+    } else if (strcmp(command, "delmonitor") == 0) {
+        return cmd_delmonitor(displays, count, screen, argv[1], err);
+    } else if (strcmp(command, "wire") == 0 || strcmp(command, "offload") == 0) {
+        return cmd_wire(displays, count, screen, strcmp(command, "offload") == 0, argc - 1, argv + 1, out, err);
+    } else if (strcmp(command, "props") == 0) {
+        return cmd_props(displays, count, argv[1], argc > 2 ? argv[2] : NULL, out, err);
+    }
+    return cmd_primary(displays, count, screen, argv[1], err);
+}
+
+/**
+ * @brief Non-interactive entry point. Does one xrandr query and at most one apply,
+ * or hands the whole request to a running daemon, which answers from its warm snapshot.
+ * @param argc Argument count from main (argv[1] is the command).
+ * @param argv Argument vector from main.
+ * @return Process exit code (0 ok, 1 failure, 2 usage error).
+ */
+int cli_main(int argc, char **argv) {
+    const char *command = argv[1];
+
+    if (strcmp(command, "help") == 0 || strcmp(command, "--help") == 0 || strcmp(command, "-h") == 0) {
+        print_usage(stdout);
+        return 0;
+    }
+    if (strcmp(command, "--daemon") == 0 || strcmp(command, "daemon") == 0) {
+        return daemon_main();
+    }
+    if (!cli_is_command(command)) {
+        fprintf(stderr, "Unknown command '%s'.\n\n", command);
+        print_usage(stderr);
+        return 2;
+    }
+
+    int rc;
+    if (daemon_request(argc - 1, argv + 1, stdout, stderr, &rc)) {
+        return rc;
+    }
+
+    int display_count = 0;
+    ScreenInfo screen;
+    Display *displays = parse_xrandr_output(&display_count, &screen, cli_needs_verbose(command));
+    if (displays == NULL) {
+        fprintf(stderr, "Failed to parse xrandr output. Is xrandr installed and in your PATH?\n");
+        return 1;
+    }
+
+    rc = cli_run(displays, display_count, &screen, argc - 1, argv + 1, stdout, stderr);
+    free_displays(displays, display_count);
+    return rc;
+}
@@ -0,0 +1,13 @@
+#ifndef CLI_H
+#define CLI_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "xrandr_parser.h"
+
+int cli_main(int argc, char **argv);
+bool cli_is_command(const char *command);
+int cli_run(Display *displays, int count, const ScreenInfo *screen, int argc, char **argv, FILE *out, FILE *err);
+void write_displays_json(FILE *out, const Display *displays, int count);
+
+#endif // CLI_H
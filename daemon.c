@@ -0,0 +1,603 @@
+// Needed for sockets, sigaction(), open_memstream() and clock_gettime() under -std=c99.
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#ifdef __linux__
+#include <linux/netlink.h>
+#endif
+#include "daemon.h"
+#include "cli.h"
+#include "display_diff.h"
+#include "xrandr_apply.h"
+#include "profiles.h"
+#include "shm_snapshot.h"
+#include "snapshot_cache.h"
+
+// Hotplug uevents come in bursts; wait this long after the last one before re-querying.
+#define HOTPLUG_SETTLE_MS 300
+// Without uevents (non-Linux, or netlink refused) we fall back to polling.
+#define POLL_INTERVAL_MS 5000
+// Longest request line a client may send.
+#define MAX_REQUEST 1024
+#define MAX_WORDS 64
+
+/*
+ * Protocol, one request per connection:
+ *   client -> daemon:  the command words, space separated, ending in '\n'
+ *                      (the same words as on the command line, e.g. "set HDMI-1 1920x1080")
+ *   daemon -> client:  "<exit status> <stdout length> <stderr length>\n" followed by both bodies
+ *
+ * Besides the cli_run() commands the daemon understands:
+ *   snapshot   raw xrandr text of the warm snapshot (clients parse it locally)
+ *   refresh    re-query xrandr first, then the same as snapshot
+ *   ping       "pong"
+ */
+
+/**
+ * @brief The snapshot the daemon keeps warm between requests.
+ */
+typedef struct {
+    char *text; // Raw xrandr --verbose output the displays were parsed from
+    size_t text_len;
+    bool polling; // No hotplug events: refreshes keep poll_text for poll_snapshot() to compare to
+    char *poll_text; // Plain xrandr output as of the last refresh
+    size_t poll_text_len;
+    Display *displays;
+    int display_count;
+    ScreenInfo screen;
+    LogicalMonitor *monitors; // RandR 1.5 monitors, from a --listmonitors query of their own
+    int monitor_count;
+    ShmPublisher shm; // Shared-memory copy for lock-free readers (shm == NULL if unavailable)
+} DaemonSnapshot;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+/**
+ * @brief Where the control socket lives: $MYRANDR_SOCKET, $XDG_RUNTIME_DIR/myrandr.sock or /tmp/myrandr-<uid>.sock.
+ * @return buf.
+ */
+const char* daemon_socket_path(char *buf, size_t size) {
+    const char *path = getenv("MYRANDR_SOCKET");
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (path && path[0] != '\0') {
+        snprintf(buf, size, "%s", path);
+    } else if (runtime_dir && runtime_dir[0] != '\0') {
+        snprintf(buf, size, "%s/myrandr.sock", runtime_dir);
+    } else {
+        snprintf(buf, size, "/tmp/myrandr-%ld.sock", (long)getuid());
+    }
+    return buf;
+}
+
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool write_full(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool read_full(int fd, void *data, size_t len) {
+    char *p = data;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads one '\n'-terminated line (without the newline).
+ * @return True if a full line fit into buf.
+ */
+static bool read_line(int fd, char *buf, size_t size) {
+    size_t len = 0;
+    while (len + 1 < size) {
+        char c;
+        ssize_t n = read(fd, &c, 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        if (c == '\n') {
+            buf[len] = '\0';
+            return true;
+        }
+        buf[len++] = c;
+    }
+    return false;
+}
+
+/**
+ * @brief Connects to the daemon's socket.
+ * @return The connected fd, or -1 if no daemon is listening.
+ */
+static int connect_daemon(void) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    daemon_socket_path(addr.sun_path, sizeof(addr.sun_path));
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Sends one request line and collects the framed response.
+ * @return False if there is no daemon or the exchange broke off.
+ */
+static bool daemon_call(const char *request, int *status, char **out, size_t *out_len, char **err, size_t *err_len) {
+    *out = NULL;
+    *err = NULL;
+
+    int fd = connect_daemon();
+    if (fd < 0) return false;
+
+    char header[64];
+    bool ok = write_full(fd, request, strlen(request)) && write_full(fd, "\n", 1) &&
+              read_line(fd, header, sizeof(header)) &&
+              sscanf(header, "%d %zu %zu", status, out_len, err_len) == 3;
+
+    if (ok) {
+        *out = malloc(*out_len + 1);
+        *err = malloc(*err_len + 1);
+        ok = *out && *err && read_full(fd, *out, *out_len) && read_full(fd, *err, *err_len);
+    }
+    close(fd);
+
+    if (!ok) {
+        free(*out);
+        free(*err);
+        *out = NULL;
+        *err = NULL;
+        return false;
+    }
+    (*out)[*out_len] = '\0';
+    (*err)[*err_len] = '\0';
+    return true;
+}
+
+/**
+ * @brief Hands a command line request to a running daemon.
+ * @param argc Number of words in argv.
+ * @param argv The command (argv[0]) and its arguments.
+ * @param out Where to copy the daemon's normal output.
+ * @param err Where to copy the daemon's error output.
+ * @param status Filled with the command's exit status.
+ * @return False if no daemon answered; the caller should then do the work itself.
+ */
+bool daemon_request(int argc, char **argv, FILE *out, FILE *err, int *status) {
+    char request[MAX_REQUEST];
+    size_t len = 0;
+    for (int i = 0; i < argc; i++) {
+        // Words are separated by single spaces, so they can't contain any themselves.
+        if (strpbrk(argv[i], " \t\n") != NULL || argv[i][0] == '\0') return false;
+        int n = snprintf(request + len, sizeof(request) - len, "%s%s", i ? " " : "", argv[i]);
+        if (n < 0 || (size_t)n >= sizeof(request) - len) return false;
+        len += n;
+    }
+
+    char *out_text, *err_text;
+    size_t out_len, err_len;
+    if (!daemon_call(request, status, &out_text, &out_len, &err_text, &err_len)) {
+        return false;
+    }
+    fwrite(out_text, 1, out_len, out);
+    fwrite(err_text, 1, err_len, err);
+    free(out_text);
+    free(err_text);
+    return true;
+}
+
+/**
+ * @brief Gets the current displays from a running daemon instead of running xrandr.
+ * @param refresh Ask the daemon to re-query first (e.g. right after we applied something).
+ * @param display_count Filled with the number of displays.
+ * @param screen Filled with the screen's framebuffer limits.
+ * @return Same as parse_xrandr_output(), or NULL if no daemon answered.
+ */
+Display* daemon_fetch_displays(bool refresh, int *display_count, ScreenInfo *screen) {
+    *display_count = 0;
+    memset(screen, 0, sizeof(ScreenInfo));
+
+    int status;
+    char *text, *err;
+    size_t text_len, err_len;
+    if (!daemon_call(refresh ? "refresh" : "snapshot", &status, &text, &text_len, &err, &err_len)) {
+        return NULL;
+    }
+
+    Display *displays = status == 0 ? parse_xrandr_text(text, text_len, display_count, screen) : NULL;
+    free(text);
+    free(err);
+    return displays;
+}
+
+/**
+ * @brief Applies the saved profile for the connected monitor set, unless it's already in effect.
+ * @return True if something was applied.
+ */
+static bool auto_apply_profile(const DaemonSnapshot *snap) {
+    ProfileStore store;
+    if (!profile_store_load(&store, NULL)) return false;
+
+    bool applied = false;
+    const Profile *profile = profile_store_find(&store, monitor_set_fingerprint(snap->displays, snap->display_count));
+    if (profile && !profile_matches_layout(profile, snap->displays, snap->display_count)) {
+        Transaction t;
+        transaction_init(&t);
+        char reason[256];
+        if (!profile_to_transaction(profile, snap->displays, snap->display_count, &t)) {
+            fprintf(stderr, "myrandr: failed to apply profile '%s'\n", profile->name);
+        } else if (!transaction_validate(&t, snap->displays, snap->display_count, &snap->screen, reason, sizeof(reason))) {
+            fprintf(stderr, "myrandr: not applying profile '%s': %s\n", profile->name, reason);
+        } else if (!transaction_assign_crtcs(&t, snap->displays, snap->display_count)) {
+            fprintf(stderr, "myrandr: failed to apply profile '%s'\n", profile->name);
+        } else {
+            transaction_plan_screen(&t, snap->displays, snap->display_count, &snap->screen);
+            applied = transaction_apply(&t) == 0;
+            fprintf(stderr, "myrandr: %s profile '%s'\n", applied ? "applied" : "failed to apply", profile->name);
+        }
+        transaction_free(&t);
+    }
+    profile_store_free(&store);
+    return applied;
+}
+
+/**
+ * @brief Re-queries xrandr, logs what changed and swaps in the new snapshot.
+ * @param snap The snapshot to update (kept as is if the query fails).
+ * @param auto_apply Apply the matching profile if monitors came or went.
+ * @return True on success, false if xrandr could not be queried.
+ */
+static bool refresh_snapshot(DaemonSnapshot *snap, bool auto_apply) {
+    // Taken first: a change that lands between the two queries then shows up at the next poll
+    if (snap->polling) {
+        size_t poll_text_len;
+        char *poll_text = read_xrandr_output(&poll_text_len, false);
+        if (poll_text == NULL) return false;
+        free(snap->poll_text);
+        snap->poll_text = poll_text;
+        snap->poll_text_len = poll_text_len;
+    }
+
+    size_t text_len;
+    char *text = read_xrandr_output(&text_len, true);
+    if (text == NULL) return false;
+
+    int display_count;
+    ScreenInfo screen;
+    Display *displays = parse_xrandr_text(text, text_len, &display_count, &screen);
+    // Shared-memory readers get full mode lists, so the daemon decodes them all up front.
+    displays_ensure_modes(displays, display_count);
+
+    DisplayEvent *events;
+    int event_count = 0;
+    bool monitors_changed = false;
+    bool first = snap->text == NULL;
+    if (diff_displays(snap->displays, snap->display_count, displays, display_count, &events, &event_count)) {
+        for (int i = 0; i < event_count; i++) {
+            // The first snapshot would just report everything as connected.
+            if (!first) {
+                char line[128];
+                format_display_event(&events[i], line, sizeof(line));
+                fprintf(stderr, "myrandr: %s\n", line);
+            }
+            if (events[i].type == DISPLAY_EVENT_CONNECTED || events[i].type == DISPLAY_EVENT_DISCONNECTED) {
+                monitors_changed = true;
+            }
+        }
+        free(events);
+    }
+
+    free_displays(snap->displays, snap->display_count);
+    free(snap->text);
+    free(snap->monitors);
+    snap->text = text;
+    snap->text_len = text_len;
+    snap->displays = displays;
+    snap->display_count = display_count;
+    snap->screen = screen;
+    snap->monitors = read_logical_monitors(&snap->monitor_count);
+    shm_publisher_publish(&snap->shm, displays, display_count, &screen, snap->monitors, snap->monitor_count);
+    if (first || event_count > 0) {
+        snapshot_cache_save(displays, display_count, &screen); // Gives the next TUI cold start a head start
+    }
+
+    if (auto_apply && monitors_changed && auto_apply_profile(snap)) {
+        return refresh_snapshot(snap, false);
+    }
+    return true;
+}
+
+/**
+ * @brief Polls for changes without hotplug events. The plain query is enough to tell whether
+ * anything changed and much cheaper than --verbose, so the full refresh only runs when it did.
+ * @return Same as refresh_snapshot(); true if nothing changed.
+ */
+static bool poll_snapshot(DaemonSnapshot *snap) {
+    size_t text_len;
+    char *text = read_xrandr_output(&text_len, false);
+    if (text == NULL) return false;
+    bool same = snap->poll_text && text_len == snap->poll_text_len && memcmp(text, snap->poll_text, text_len) == 0;
+    free(text);
+    return same || refresh_snapshot(snap, true);
+}
+
+/**
+ * @brief Runs one request against the warm snapshot.
+ * @return The exit status to report; out/err receive the bodies.
+ */
+static int run_request(DaemonSnapshot *snap, char *request, FILE *out, FILE *err) {
+    char *words[MAX_WORDS];
+    int count = 0;
+    for (char *word = strtok(request, " "); word && count < MAX_WORDS; word = strtok(NULL, " ")) {
+        words[count++] = word;
+    }
+    if (count == 0) {
+        fprintf(err, "Empty request.\n");
+        return 2;
+    }
+
+    if (strcmp(words[0], "ping") == 0) {
+        fprintf(out, "pong\n");
+        return 0;
+    }
+    if (strcmp(words[0], "refresh") == 0 && !refresh_snapshot(snap, false)) {
+        fprintf(err, "Failed to query xrandr.\n");
+        return 1;
+    }
+    if (strcmp(words[0], "snapshot") == 0 || strcmp(words[0], "refresh") == 0) {
+        if (snap->text) fwrite(snap->text, 1, snap->text_len, out);
+        return 0;
+    }
+
+    int status = cli_run(snap->displays, snap->display_count, &snap->screen, count, words, out, err);
+    bool changes_layout = strcmp(words[0], "apply") == 0 || strcmp(words[0], "set") == 0 ||
+                          strcmp(words[0], "primary") == 0 || strcmp(words[0], "wall") == 0 ||
+                          strcmp(words[0], "normalize") == 0 || strcmp(words[0], "setmonitor") == 0 ||
+                          strcmp(words[0], "delmonitor") == 0;
+    if (status == 0 && changes_layout) {
+        // RandR changes don't show up as uevents, so pick them up ourselves.
+        refresh_snapshot(snap, false);
+    }
+    return status;
+}
+
+/**
+ * @brief Serves a single client connection.
+ */
+static void handle_client(DaemonSnapshot *snap, int fd) {
+    // Don't let a client that never finishes its line stall everyone else, nor one that
+    // never reads a reply bigger than the socket buffer: writes give up and drop it too.
+    struct timeval timeout = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char request[MAX_REQUEST];
+    if (!read_line(fd, request, sizeof(request))) return;
+
+    char *out_text = NULL, *err_text = NULL;
+    size_t out_len = 0, err_len = 0;
+    FILE *out = open_memstream(&out_text, &out_len);
+    FILE *err = open_memstream(&err_text, &err_len);
+    int status = 1;
+    if (out && err) {
+        status = run_request(snap, request, out, err);
+    }
+    if (out) fclose(out);
+    if (err) fclose(err);
+
+    char header[64];
+    int header_len = snprintf(header, sizeof(header), "%d %zu %zu\n", status, out_len, err_len);
+    if (write_full(fd, header, header_len)) {
+        if (write_full(fd, out_text ? out_text : "", out_len)) {
+            write_full(fd, err_text ? err_text : "", err_len);
+        }
+    }
+    free(out_text);
+    free(err_text);
+}
+
+/**
+ * @brief Opens the kernel uevent socket so we hear about connector hotplugs.
+ * @return The fd, or -1 if uevents are unavailable.
+ */
+static int open_hotplug_socket(void) {
+#ifdef __linux__
+    int fd = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0) return -1;
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1; // Kernel uevent broadcast group
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * @brief Reads one uevent and checks whether it's a DRM hotplug.
+ * Messages are a NUL-separated list: "change@/devices/...", "SUBSYSTEM=drm", "HOTPLUG=1", ...
+ */
+static bool read_hotplug_event(int fd) {
+    char buf[4096];
+    ssize_t len = recv(fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0) return false;
+    buf[len] = '\0';
+
+    bool is_drm = false, is_hotplug = false;
+    for (char *p = buf; p < buf + len; p += strlen(p) + 1) {
+        if (strcmp(p, "SUBSYSTEM=drm") == 0) is_drm = true;
+        if (strcmp(p, "HOTPLUG=1") == 0) is_hotplug = true;
+    }
+    return is_drm && is_hotplug;
+}
+
+/**
+ * @brief Creates the listening control socket, replacing a stale one.
+ * @return The fd, or -1 on failure (including "another daemon is running").
+ */
+static int open_control_socket(const char *path) {
+    int existing = connect_daemon();
+    if (existing >= 0) {
+        close(existing);
+        fprintf(stderr, "myrandr: a daemon is already listening on %s\n", path);
+        return -1;
+    }
+    unlink(path); // Left over from a daemon that didn't exit cleanly
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("Failed to create control socket");
+        return -1;
+    }
+    mode_t old_umask = umask(0077); // Only our user may drive the displays
+    int rc = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_umask);
+    if (rc != 0 || listen(fd, 16) != 0) {
+        perror("Failed to listen on control socket");
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+/**
+ * @brief Entry point of "myrandr --daemon". Runs until SIGINT/SIGTERM.
+ * @return Process exit code.
+ */
+int daemon_main(void) {
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    daemon_socket_path(path, sizeof(path));
+
+    int listen_fd = open_control_socket(path);
+    if (listen_fd < 0) {
+        return 1;
+    }
+
+    DaemonSnapshot snap;
+    memset(&snap, 0, sizeof(snap));
+    if (!shm_publisher_open(&snap.shm)) {
+        fprintf(stderr, "myrandr: continuing without a shared-memory snapshot\n");
+    }
+    int hotplug_fd = open_hotplug_socket();
+    snap.polling = hotplug_fd < 0;
+    if (!refresh_snapshot(&snap, true)) {
+        fprintf(stderr, "Failed to parse xrandr output. Is xrandr installed and in your PATH?\n");
+        if (hotplug_fd >= 0) close(hotplug_fd);
+        shm_publisher_close(&snap.shm);
+        close(listen_fd);
+        unlink(path);
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN); // A client hanging up must not kill us
+
+    fprintf(stderr, "myrandr: listening on %s (%s)\n", path,
+            hotplug_fd >= 0 ? "hotplug events" : "polling");
+
+    long long refresh_deadline = hotplug_fd >= 0 ? -1 : monotonic_ms() + POLL_INTERVAL_MS;
+    while (!stop_requested) {
+        struct pollfd fds[2];
+        int nfds = 0;
+        fds[nfds].fd = listen_fd;
+        fds[nfds++].events = POLLIN;
+        if (hotplug_fd >= 0) {
+            fds[nfds].fd = hotplug_fd;
+            fds[nfds++].events = POLLIN;
+        }
+
+        int timeout = -1;
+        if (refresh_deadline >= 0) {
+            long long remaining = refresh_deadline - monotonic_ms();
+            timeout = remaining > 0 ? (int)remaining : 0;
+        }
+
+        int ready = poll(fds, nfds, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+
+        if (refresh_deadline >= 0 && monotonic_ms() >= refresh_deadline) {
+            // A hotplug event means something changed; a poll has to find out first
+            if (hotplug_fd >= 0) refresh_snapshot(&snap, true);
+            else poll_snapshot(&snap);
+            refresh_deadline = hotplug_fd >= 0 ? -1 : monotonic_ms() + POLL_INTERVAL_MS;
+        }
+        if (hotplug_fd >= 0 && (fds[1].revents & POLLIN) && read_hotplug_event(hotplug_fd)) {
+            refresh_deadline = monotonic_ms() + HOTPLUG_SETTLE_MS;
+        }
+        if (fds[0].revents & POLLIN) {
+            int client = accept(listen_fd, NULL, NULL);
+            if (client >= 0) {
+                handle_client(&snap, client);
+                close(client);
+            }
+        }
+    }
+
+    close(listen_fd);
+    if (hotplug_fd >= 0) close(hotplug_fd);
+    unlink(path);
+    shm_publisher_close(&snap.shm);
+    free_displays(snap.displays, snap.display_count);
+    free(snap.text);
+    free(snap.poll_text);
+    free(snap.monitors);
+    fprintf(stderr, "myrandr: daemon stopped\n");
+    return 0;
+}
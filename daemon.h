@@ -0,0 +1,14 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "xrandr_parser.h"
+
+int daemon_main(void);
+const char* daemon_socket_path(char *buf, size_t size);
+bool daemon_request(int argc, char **argv, FILE *out, FILE *err, int *status);
+Display* daemon_fetch_displays(bool refresh, int *display_count, ScreenInfo *screen);
+
+#endif // DAEMON_H
@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "display_diff.h"
+#include "hash.h"
+
+/**
+ * @brief Builds a name -> position index over a display array.
+ * The index only borrows the array, so keep it alive while the index is used.
+ * @param index The index to fill.
+ * @param displays An array of Display structs.
+ * @param count The number of displays in the array.
+ * @return True on success, false on failure.
+ */
+bool display_index_build(DisplayIndex *index, const Display *displays, int count) {
+    index->displays = displays;
+    index->capacity = 8;
+    // Keep the load factor at or below 1/2 so probe chains stay short.
+    while (index->capacity < count * 2) {
+        index->capacity *= 2;
+    }
+
+    index->slots = malloc(index->capacity * sizeof(int));
+    if (index->slots == NULL) {
+        index->capacity = 0;
+        return false;
+    }
+    memset(index->slots, -1, index->capacity * sizeof(int));
+
+    for (int i = 0; i < count; i++) {
+        const char *name = displays[i].name;
+        int slot = (int)(fnv1a_64(name, strlen(name), FNV1A_64_INIT) & (uint64_t)(index->capacity - 1));
+        while (index->slots[slot] != -1) {
+            slot = (slot + 1) & (index->capacity - 1);
+        }
+        index->slots[slot] = i;
+    }
+    return true;
+}
+
+/**
+ * @brief Looks up a display by output name.
+ * @return The position in the indexed array, or -1 if not found.
+ */
+int display_index_find(const DisplayIndex *index, const char *name) {
+    if (index->capacity == 0) return -1;
+
+    int slot = (int)(fnv1a_64(name, strlen(name), FNV1A_64_INIT) & (uint64_t)(index->capacity - 1));
+    while (index->slots[slot] != -1) {
+        int i = index->slots[slot];
+        if (strcmp(index->displays[i].name, name) == 0) {
+            return i;
+        }
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+    return -1;
+}
+
+void display_index_free(DisplayIndex *index) {
+    free(index->slots);
+    index->slots = NULL;
+    index->capacity = 0;
+}
+
+/**
+ * @brief Copies the event-relevant fields of a display.
+ */
+static DisplayState capture_state(const Display *d) {
+    DisplayState s;
+    memset(&s, 0, sizeof(s));
+    s.connected = d->connected;
+    s.is_active = d->is_active;
+    s.is_primary = d->is_primary;
+    s.width = d->width;
+    s.height = d->height;
+    s.x_offset = d->x_offset;
+    s.y_offset = d->y_offset;
+    s.rate = d->current_rate;
+    snprintf(s.mode_name, sizeof(s.mode_name), "%s", d->mode_name);
+    return s;
+}
+
+/**
+ * @brief Growable event list used while diffing.
+ */
+typedef struct {
+    DisplayEvent *items;
+    int count;
+    int capacity;
+} EventList;
+
+static bool push_event(EventList *list, DisplayEventType type, const char *name,
+                       const DisplayState *before, const DisplayState *after) {
+    if (list->count == list->capacity) {
+        int new_capacity = list->capacity ? list->capacity * 2 : 8;
+        DisplayEvent *temp = realloc(list->items, new_capacity * sizeof(DisplayEvent));
+        if (temp == NULL) {
+            perror("Failed to reallocate memory for display events");
+            return false;
+        }
+        list->items = temp;
+        list->capacity = new_capacity;
+    }
+
+    DisplayEvent *event = &list->items[list->count++];
+    memset(event, 0, sizeof(DisplayEvent));
+    event->type = type;
+    snprintf(event->name, sizeof(event->name), "%s", name);
+    if (before) event->before = *before;
+    if (after) event->after = *after;
+    return true;
+}
+
+/**
+ * @brief Rates are exact fractions now, but cached snapshots keep them in mHz,
+ * so anything under a thousandth of a hertz is the same rate.
+ */
+static bool rates_differ(double a, double b) {
+    double diff = a - b;
+    return diff > 0.001 || diff < -0.001;
+}
+
+/**
+ * @brief Emits the events for an output present in both snapshots.
+ */
+static bool diff_one(EventList *list, const Display *o, const Display *n) {
+    DisplayState before = capture_state(o);
+    DisplayState after = capture_state(n);
+    bool ok = true;
+
+    if (before.connected != after.connected) {
+        ok = ok && push_event(list, after.connected ? DISPLAY_EVENT_CONNECTED : DISPLAY_EVENT_DISCONNECTED,
+                              n->name, &before, &after);
+    }
+    if (before.is_active != after.is_active) {
+        ok = ok && push_event(list, after.is_active ? DISPLAY_EVENT_ENABLED : DISPLAY_EVENT_DISABLED,
+                              n->name, &before, &after);
+    }
+    // Geometry only means something while the output is lit on both sides.
+    if (before.is_active && after.is_active) {
+        // Same size but another name is still a mode change, e.g. 1920x1080 to 1920x1080i
+        bool renamed = before.mode_name[0] != '\0' && after.mode_name[0] != '\0' &&
+                       strcmp(before.mode_name, after.mode_name) != 0;
+        if (before.width != after.width || before.height != after.height || renamed) {
+            ok = ok && push_event(list, DISPLAY_EVENT_MODE_CHANGED, n->name, &before, &after);
+        } else if (rates_differ(before.rate, after.rate)) {
+            ok = ok && push_event(list, DISPLAY_EVENT_RATE_CHANGED, n->name, &before, &after);
+        }
+        if (before.x_offset != after.x_offset || before.y_offset != after.y_offset) {
+            ok = ok && push_event(list, DISPLAY_EVENT_MOVED, n->name, &before, &after);
+        }
+    }
+    if (before.is_primary != after.is_primary) {
+        ok = ok && push_event(list, DISPLAY_EVENT_PRIMARY_CHANGED, n->name, &before, &after);
+    }
+    // Compared by signature, so neither side's mode list has to be decoded.
+    if (o->mode_signature != n->mode_signature) {
+        ok = ok && push_event(list, DISPLAY_EVENT_MODE_LIST_CHANGED, n->name, &before, &after);
+    }
+    return ok;
+}
+
+/**
+ * @brief Compares two parsed snapshots and lists what changed, output by output.
+ * Runs in O(n) over outputs by indexing the old snapshot by name.
+ * @param old_displays The previous snapshot.
+ * @param old_count Number of displays in the previous snapshot.
+ * @param new_displays The current snapshot.
+ * @param new_count Number of displays in the current snapshot.
+ * @param events Filled with a malloc'd array of events (NULL if nothing changed). Free it with free().
+ * @param event_count Filled with the number of events.
+ * @return True on success, false on failure.
+ */
+bool diff_displays(const Display *old_displays, int old_count,
+                   const Display *new_displays, int new_count,
+                   DisplayEvent **events, int *event_count) {
+    *events = NULL;
+    *event_count = 0;
+
+    DisplayIndex old_index;
+    if (!display_index_build(&old_index, old_displays, old_count)) {
+        return false;
+    }
+
+    EventList list = {NULL, 0, 0};
+    // Marks which old outputs still exist, so the leftovers are the disconnected ones.
+    char *seen = calloc(old_count > 0 ? old_count : 1, 1);
+    bool ok = seen != NULL;
+
+    for (int i = 0; ok && i < new_count; i++) {
+        const Display *n = &new_displays[i];
+        int j = display_index_find(&old_index, n->name);
+        if (j < 0) {
+            if (n->connected) {
+                DisplayState after = capture_state(n);
+                ok = push_event(&list, DISPLAY_EVENT_CONNECTED, n->name, NULL, &after);
+            }
+            continue;
+        }
+        seen[j] = 1;
+        ok = diff_one(&list, &old_displays[j], n);
+    }
+
+    for (int j = 0; ok && j < old_count; j++) {
+        if (!seen[j] && old_displays[j].connected) {
+            DisplayState before = capture_state(&old_displays[j]);
+            ok = push_event(&list, DISPLAY_EVENT_DISCONNECTED, old_displays[j].name, &before, NULL);
+        }
+    }
+
+    free(seen);
+    display_index_free(&old_index);
+
+    if (!ok) {
+        free(list.items);
+        return false;
+    }
+    *events = list.items;
+    *event_count = list.count;
+    return true;
+}
+
+/**
+ * @brief Short, stable name for an event type (used in logs and hooks).
+ */
+const char* display_event_name(DisplayEventType type) {
+    switch (type) {
+        case DISPLAY_EVENT_CONNECTED:         return "connected";
+        case DISPLAY_EVENT_DISCONNECTED:      return "disconnected";
+        case DISPLAY_EVENT_ENABLED:           return "enabled";
+        case DISPLAY_EVENT_DISABLED:          return "disabled";
+        case DISPLAY_EVENT_MODE_CHANGED:      return "mode-changed";
+        case DISPLAY_EVENT_RATE_CHANGED:      return "rate-changed";
+        case DISPLAY_EVENT_MOVED:             return "moved";
+        case DISPLAY_EVENT_PRIMARY_CHANGED:   return "primary-changed";
+        case DISPLAY_EVENT_MODE_LIST_CHANGED: return "mode-list-changed";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Writes a one-line, human readable description of an event.
+ * @param event The event to describe.
+ * @param buf Destination buffer.
+ * @param size Size of the destination buffer.
+ */
+void format_display_event(const DisplayEvent *event, char *buf, size_t size) {
+    const DisplayState *b = &event->before;
+    const DisplayState *a = &event->after;
+
+    switch (event->type) {
+        case DISPLAY_EVENT_MODE_CHANGED:
+            if (b->mode_name[0] != '\0' && a->mode_name[0] != '\0') {
+                snprintf(buf, size, "%s: mode %s -> %s", event->name, b->mode_name, a->mode_name);
+            } else {
+                snprintf(buf, size, "%s: mode %dx%d -> %dx%d", event->name, b->width, b->height, a->width, a->height);
+            }
+            break;
+        case DISPLAY_EVENT_RATE_CHANGED:
+            snprintf(buf, size, "%s: rate %.3fHz -> %.3fHz", event->name, b->rate, a->rate);
+            break;
+        case DISPLAY_EVENT_MOVED:
+            snprintf(buf, size, "%s: moved +%d+%d -> +%d+%d", event->name, b->x_offset, b->y_offset, a->x_offset, a->y_offset);
+            break;
+        case DISPLAY_EVENT_PRIMARY_CHANGED:
+            snprintf(buf, size, "%s: %s", event->name, a->is_primary ? "now primary" : "no longer primary");
+            break;
+        default:
+            snprintf(buf, size, "%s: %s", event->name, display_event_name(event->type));
+            break;
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef DISPLAY_DIFF_H
+#define DISPLAY_DIFF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "xrandr_parser.h"
+
+/**
+ * @brief Kinds of changes between two parsed snapshots.
+ */
+typedef enum {
+    DISPLAY_EVENT_CONNECTED,
+    DISPLAY_EVENT_DISCONNECTED,
+    DISPLAY_EVENT_ENABLED,
+    DISPLAY_EVENT_DISABLED,
+    DISPLAY_EVENT_MODE_CHANGED,
+    DISPLAY_EVENT_RATE_CHANGED,
+    DISPLAY_EVENT_MOVED,
+    DISPLAY_EVENT_PRIMARY_CHANGED,
+    DISPLAY_EVENT_MODE_LIST_CHANGED
+} DisplayEventType;
+
+/**
+ * @brief The parts of a display an event can talk about.
+ * Copied by value so events stay valid after the snapshots are freed.
+ */
+typedef struct {
+    int connected;
+    int is_active;
+    int is_primary;
+    int width;
+    int height;
+    int x_offset;
+    int y_offset;
+    double rate; // 0.0 if no current rate
+    char mode_name[32];
+} DisplayState;
+
+/**
+ * @brief A single change of a single output.
+ */
+typedef struct {
+    DisplayEventType type;
+    char name[32];
+    DisplayState before; // Zeroed for DISPLAY_EVENT_CONNECTED
+    DisplayState after;  // Zeroed for DISPLAY_EVENT_DISCONNECTED
+} DisplayEvent;
+
+/**
+ * @brief Open-addressing hash index from output name to array position.
+ */
+typedef struct {
+    const Display *displays;
+    int *slots;   // -1 marks an empty slot
+    int capacity; // Always a power of two
+} DisplayIndex;
+
+bool display_index_build(DisplayIndex *index, const Display *displays, int count);
+int display_index_find(const DisplayIndex *index, const char *name);
+void display_index_free(DisplayIndex *index);
+
+bool diff_displays(const Display *old_displays, int old_count,
+                   const Display *new_displays, int new_count,
+                   DisplayEvent **events, int *event_count);
+const char* display_event_name(DisplayEventType type);
+void format_display_event(const DisplayEvent *event, char *buf, size_t size);
+
+#endif // DISPLAY_DIFF_H
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "edid.h"
+#include "hash.h"
+
+#define EDID_BLOCK_SIZE 128
+
+/**
+ * @brief One decoded EDID, keyed by the hash of its bytes.
+ * The bytes are kept so a (very unlikely) hash collision can't hand out the wrong monitor.
+ */
+typedef struct {
+    uint64_t hash;
+    unsigned char *bytes;
+    size_t len;
+    int valid;
+    EdidInfo info;
+} EdidCacheEntry;
+
+// Entries are allocated one by one, so pointers handed out stay valid when the table grows.
+static EdidCacheEntry **cache_slots = NULL;
+static int cache_capacity = 0;
+static int cache_count = 0;
+
+static bool block_checksum_ok(const unsigned char *block) {
+    unsigned char sum = 0;
+    for (int i = 0; i < EDID_BLOCK_SIZE; i++) sum += block[i];
+    return sum == 0;
+}
+
+/**
+ * @brief Copies a text descriptor (terminated by 0x0a, padded with spaces).
+ */
+static void decode_text_descriptor(const unsigned char *desc, char *out, size_t size) {
+    size_t len = 0;
+    for (int i = 5; i < 18 && len + 1 < size; i++) {
+        if (desc[i] == 0x0a || desc[i] == 0x00) break;
+        out[len++] = (desc[i] >= 0x20 && desc[i] < 0x7f) ? (char)desc[i] : '?';
+    }
+    while (len > 0 && out[len - 1] == ' ') len--;
+    out[len] = '\0';
+}
+
+/**
+ * @brief Decodes an 18-byte detailed timing descriptor.
+ */
+static void decode_timing(const unsigned char *d, EdidTiming *t) {
+    memset(t, 0, sizeof(EdidTiming));
+    int clock_10khz = d[0] | (d[1] << 8);
+    t->pixel_clock = clock_10khz / 100.0;
+    t->h_active = d[2] | ((d[4] & 0xf0) << 4);
+    t->h_blank = d[3] | ((d[4] & 0x0f) << 8);
+    t->v_active = d[5] | ((d[7] & 0xf0) << 4);
+    t->v_blank = d[6] | ((d[7] & 0x0f) << 8);
+    t->h_sync_offset = d[8] | ((d[11] & 0xc0) << 2);
+    t->h_sync_width = d[9] | ((d[11] & 0x30) << 4);
+    t->v_sync_offset = (d[10] >> 4) | ((d[11] & 0x0c) << 2);
+    t->v_sync_width = (d[10] & 0x0f) | ((d[11] & 0x03) << 4);
+    t->width_mm = d[12] | ((d[14] & 0xf0) << 4);
+    t->height_mm = d[13] | ((d[14] & 0x0f) << 8);
+    t->interlaced = (d[17] & 0x80) != 0;
+
+    long total = (long)(t->h_active + t->h_blank) * (t->v_active + t->v_blank);
+    if (total > 0) {
+        t->refresh = clock_10khz * 10000.0 / total;
+    }
+}
+
+/**
+ * @brief Walks the data blocks of a CTA-861 extension.
+ */
+static void decode_cta_block(const unsigned char *block, EdidInfo *info) {
+    info->has_cta = 1;
+    info->cta_revision = block[1];
+    int dtd_offset = block[2];
+    if (info->cta_revision >= 2) {
+        info->underscan = (block[3] & 0x80) != 0;
+        info->basic_audio = (block[3] & 0x40) != 0;
+        info->ycbcr444 = (block[3] & 0x20) != 0;
+        info->ycbcr422 = (block[3] & 0x10) != 0;
+    }
+    if (dtd_offset < 4 || dtd_offset > EDID_BLOCK_SIZE - 1) dtd_offset = 4; // No data blocks
+
+    int pos = 4;
+    while (pos < dtd_offset) {
+        int tag = block[pos] >> 5;
+        int len = block[pos] & 0x1f;
+        const unsigned char *payload = &block[pos + 1];
+        if (pos + 1 + len > dtd_offset) break; // Truncated block
+
+        if (tag == 2) {
+            // Video data block: one short video descriptor per byte
+            for (int i = 0; i < len && info->vic_count < EDID_MAX_VICS; i++) {
+                int svd = payload[i];
+                int vic = svd;
+                // VICs 1-64 can carry a "native" bit; 193 and up are real codes
+                if (svd >= 129 && svd <= 192) {
+                    vic = svd & 0x7f;
+                    if (info->native_vic == 0) info->native_vic = vic;
+                }
+                info->vics[info->vic_count++] = (uint8_t)vic;
+            }
+        } else if (tag == 3 && len >= 3) {
+            // Vendor-specific data block, told apart by its IEEE OUI (little-endian)
+            uint32_t oui = payload[0] | (payload[1] << 8) | ((uint32_t)payload[2] << 16);
+            if (oui == 0x000c03) info->hdmi = 1;
+            if (oui == 0xc45dd8) info->hdmi_forum = 1;
+        }
+        pos += 1 + len;
+    }
+}
+
+/**
+ * @brief Decodes a raw EDID without looking at the cache.
+ * @return True if the base block is a valid EDID.
+ */
+static bool decode_edid(const unsigned char *edid, size_t len, EdidInfo *info) {
+    static const unsigned char header[8] = {0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00};
+    memset(info, 0, sizeof(EdidInfo));
+    if (len < EDID_BLOCK_SIZE || memcmp(edid, header, sizeof(header)) != 0 || !block_checksum_ok(edid)) {
+        return false;
+    }
+
+    // Three 5-bit letters, 'A' is 1
+    int id = (edid[8] << 8) | edid[9];
+    info->manufacturer[0] = (char)('A' - 1 + ((id >> 10) & 0x1f));
+    info->manufacturer[1] = (char)('A' - 1 + ((id >> 5) & 0x1f));
+    info->manufacturer[2] = (char)('A' - 1 + (id & 0x1f));
+    info->manufacturer[3] = '\0';
+    info->product_code = (uint16_t)(edid[10] | (edid[11] << 8));
+    info->serial = (uint32_t)edid[12] | ((uint32_t)edid[13] << 8) | ((uint32_t)edid[14] << 16) | ((uint32_t)edid[15] << 24);
+    info->week = edid[16];
+    info->year = 1990 + edid[17];
+    info->version = edid[18];
+    info->revision = edid[19];
+    info->width_mm = edid[21] * 10; // Only centimetres here; the native timing is more precise
+    info->height_mm = edid[22] * 10;
+
+    for (int i = 0; i < 4; i++) {
+        const unsigned char *desc = &edid[54 + 18 * i];
+        if (desc[0] != 0 || desc[1] != 0) {
+            if (!info->has_native) {
+                decode_timing(desc, &info->native);
+                info->has_native = 1;
+            }
+        } else if (desc[3] == 0xfc) {
+            decode_text_descriptor(desc, info->model, sizeof(info->model));
+        } else if (desc[3] == 0xff) {
+            decode_text_descriptor(desc, info->serial_text, sizeof(info->serial_text));
+        }
+    }
+    if (info->has_native && info->native.width_mm > 0 && info->native.height_mm > 0) {
+        info->width_mm = info->native.width_mm;
+        info->height_mm = info->native.height_mm;
+    }
+
+    info->extension_count = edid[126];
+    for (int i = 1; i <= info->extension_count && (size_t)(i + 1) * EDID_BLOCK_SIZE <= len; i++) {
+        const unsigned char *block = &edid[i * EDID_BLOCK_SIZE];
+        if (block[0] == 0x02 && block_checksum_ok(block) && !info->has_cta) {
+            decode_cta_block(block, info);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Grows the cache table and re-inserts everything.
+ */
+static bool grow_cache(void) {
+    int capacity = cache_capacity ? cache_capacity * 2 : 16;
+    EdidCacheEntry **slots = calloc(capacity, sizeof(EdidCacheEntry *));
+    if (slots == NULL) {
+        perror("Failed to allocate EDID cache");
+        return false;
+    }
+    for (int i = 0; i < cache_capacity; i++) {
+        EdidCacheEntry *e = cache_slots[i];
+        if (e == NULL) continue;
+        int slot = (int)(e->hash & (uint64_t)(capacity - 1));
+        while (slots[slot] != NULL) slot = (slot + 1) & (capacity - 1);
+        slots[slot] = e;
+    }
+    free(cache_slots);
+    cache_slots = slots;
+    cache_capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief Decodes an EDID, or finds it in the cache if this monitor was seen before.
+ * A monitor that's queried again costs one hash and one lookup.
+ * @param edid Raw EDID bytes (base block plus extensions).
+ * @param len Number of bytes.
+ * @return The decoded info (owned by the cache, valid for the life of the process),
+ *         or NULL if the EDID is missing or broken.
+ */
+const EdidInfo* edid_decode(const unsigned char *edid, size_t len) {
+    if (edid == NULL || len == 0) return NULL;
+
+    uint64_t hash = fnv1a_64(edid, len, FNV1A_64_INIT);
+    if (cache_capacity > 0) {
+        int slot = (int)(hash & (uint64_t)(cache_capacity - 1));
+        while (cache_slots[slot] != NULL) {
+            const EdidCacheEntry *e = cache_slots[slot];
+            if (e->hash == hash && e->len == len && memcmp(e->bytes, edid, len) == 0) {
+                return e->valid ? &e->info : NULL;
+            }
+            slot = (slot + 1) & (cache_capacity - 1);
+        }
+    }
+
+    // Broken EDIDs are cached too, so they're only looked at once.
+    if ((cache_count + 1) * 2 > cache_capacity && !grow_cache()) return NULL;
+    EdidCacheEntry *e = malloc(sizeof(EdidCacheEntry));
+    unsigned char *bytes = malloc(len);
+    if (e == NULL || bytes == NULL) {
+        perror("Failed to allocate EDID cache entry");
+        free(e);
+        free(bytes);
+        return NULL;
+    }
+    memcpy(bytes, edid, len);
+    e->hash = hash;
+    e->bytes = bytes;
+    e->len = len;
+    e->valid = decode_edid(edid, len, &e->info);
+
+    int slot = (int)(hash & (uint64_t)(cache_capacity - 1));
+    while (cache_slots[slot] != NULL) slot = (slot + 1) & (cache_capacity - 1);
+    cache_slots[slot] = e;
+    cache_count++;
+    return e->valid ? &e->info : NULL;
+}
+
+/**
+ * @brief The decoded EDID of an output, NULL if xrandr didn't give us one.
+ */
+const EdidInfo* display_edid(const Display *display) {
+    return edid_decode(display->edid, display->edid_len);
+}
+
+/**
+ * @brief Stable identity of a monitor: manufacturer, product and serial from its EDID,
+ * so it stays the same when the monitor shows up on another connector.
+ * Without an EDID, the connector name is the best we have.
+ */
+uint64_t display_identity(const Display *display) {
+    const EdidInfo *info = display_edid(display);
+    if (info == NULL) {
+        return fnv1a_64(display->name, strlen(display->name), FNV1A_64_INIT);
+    }
+
+    uint64_t h = fnv1a_64(info->manufacturer, sizeof(info->manufacturer), FNV1A_64_INIT);
+    h = fnv1a_64(&info->product_code, sizeof(info->product_code), h);
+    h = fnv1a_64(&info->serial, sizeof(info->serial), h);
+    return fnv1a_64(info->serial_text, strlen(info->serial_text), h);
+}
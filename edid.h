@@ -0,0 +1,52 @@
+#ifndef EDID_H
+#define EDID_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "xrandr_parser.h"
+
+#define EDID_MAX_VICS 64
+
+/**
+ * @brief A detailed timing descriptor, e.g. the monitor's native mode.
+ */
+typedef struct {
+    double pixel_clock; // MHz
+    int h_active, h_blank, h_sync_offset, h_sync_width;
+    int v_active, v_blank, v_sync_offset, v_sync_width;
+    int width_mm, height_mm;
+    int interlaced;
+    double refresh;     // Hz, worked out from the above
+} EdidTiming;
+
+/**
+ * @brief What we care about from an EDID: who made the monitor, which one it is, and what it wants.
+ */
+typedef struct {
+    char manufacturer[4]; // PNP ID, e.g. "DEL"
+    uint16_t product_code;
+    uint32_t serial;      // Numeric serial from the header, often 0
+    char serial_text[14]; // Serial number descriptor, "" if there is none
+    char model[14];       // Monitor name descriptor, e.g. "DELL U2719D"
+    int week, year;       // Week 0xff means year is the model year
+    int version, revision;
+    int width_mm, height_mm;
+    int has_native;
+    EdidTiming native;    // First detailed timing, the preferred mode
+    int extension_count;
+    // CTA-861 extension block, if there is one
+    int has_cta;
+    int cta_revision;
+    int underscan, basic_audio, ycbcr444, ycbcr422;
+    int hdmi;             // HDMI 1.x vendor-specific data block
+    int hdmi_forum;       // HDMI Forum (2.x) vendor-specific data block
+    uint8_t vics[EDID_MAX_VICS]; // Short video descriptors (CTA VIC codes)
+    int vic_count;
+    int native_vic;       // VIC flagged as native, 0 if none
+} EdidInfo;
+
+const EdidInfo* edid_decode(const unsigned char *edid, size_t len);
+const EdidInfo* display_edid(const Display *display);
+uint64_t display_identity(const Display *display);
+
+#endif // EDID_H
@@ -0,0 +1,82 @@
+/*
+ * Example client for the shared-memory snapshot: prints one line per
+ * active output, e.g. "HDMI-1 2560x1440+1920+0 59.95Hz primary".
+ *
+ *   shm_status        print once
+ *   shm_status -w     keep printing whenever the daemon publishes a change
+ *   shm_status -m     print the RandR monitors instead, e.g. "LEFT 1720x1440+0+0 DP-2"
+ *
+ * Build with "make examples".
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../shm_reader.h"
+
+static void print_outputs(const SnapshotOutput *outputs, int count) {
+    for (int i = 0; i < count; i++) {
+        const SnapshotOutput *o = &outputs[i];
+        if (!o->is_active) continue;
+        printf("%s %dx%d+%d+%d %.2fHz%s", o->name, o->width, o->height, o->x_offset, o->y_offset,
+               o->rate_mhz / 1000.0, o->is_primary ? " primary" : "");
+        if (o->model[0] != '\0') printf(" (%.*s)", (int)sizeof(o->model), o->model);
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+static void print_monitors(const SnapshotMonitor *monitors, int count) {
+    for (int i = 0; i < count; i++) {
+        const SnapshotMonitor *m = &monitors[i];
+        printf("%.*s %dx%d+%d+%d %.*s%s\n", (int)sizeof(m->name), m->name, m->width, m->height, m->x_offset,
+               m->y_offset, (int)sizeof(m->outputs), m->outputs[0] ? m->outputs : "none", m->is_primary ? " primary" : "");
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    int watch = argc > 1 && strcmp(argv[1], "-w") == 0;
+
+    MyrandrShmReader reader;
+    if (!myrandr_shm_attach(&reader)) {
+        fprintf(stderr, "No snapshot published. Is 'myrandr --daemon' running?\n");
+        return 1;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "-m") == 0) {
+        SnapshotMonitor monitors[SNAPSHOT_MAX_MONITORS];
+        int count = myrandr_shm_read_monitors(&reader, monitors, SNAPSHOT_MAX_MONITORS, NULL);
+        if (count >= 0) print_monitors(monitors, count);
+        else fprintf(stderr, "Could not get a consistent snapshot.\n");
+        myrandr_shm_detach(&reader);
+        return count >= 0 ? 0 : 1;
+    }
+
+    SnapshotOutput outputs[SNAPSHOT_MAX_OUTPUTS];
+    uint32_t last_sequence = 0;
+    int count = myrandr_shm_read_outputs(&reader, outputs, SNAPSHOT_MAX_OUTPUTS, &last_sequence);
+    if (count < 0) {
+        fprintf(stderr, "Could not get a consistent snapshot.\n");
+        myrandr_shm_detach(&reader);
+        return 1;
+    }
+    print_outputs(outputs, count);
+
+    // Polling the sequence number is just a memory load, so a short interval is fine.
+    struct timespec interval = {0, 250 * 1000000L};
+    while (watch && !myrandr_shm_is_stale(&reader)) {
+        nanosleep(&interval, NULL);
+        if (myrandr_shm_sequence(&reader) == last_sequence) continue;
+
+        count = myrandr_shm_read_outputs(&reader, outputs, SNAPSHOT_MAX_OUTPUTS, &last_sequence);
+        if (count >= 0) {
+            printf("--\n");
+            print_outputs(outputs, count);
+        }
+    }
+
+    myrandr_shm_detach(&reader);
+    return 0;
+}
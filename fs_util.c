@@ -0,0 +1,52 @@
+// Needed for mkdir() under -std=c99.
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "fs_util.h"
+
+/**
+ * @brief mkdir -p for the directories leading up to a file.
+ * @return True on success, false on failure.
+ */
+bool make_parent_dirs(const char *path) {
+    char dir[1024];
+    if (snprintf(dir, sizeof(dir), "%s", path) >= (int)sizeof(dir)) return false;
+
+    for (char *p = dir + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+            perror("Failed to create directory");
+            return false;
+        }
+        *p = '/';
+    }
+    return true;
+}
+
+/**
+ * @brief Writes a whole file via a temp file and rename(), so readers never see half of it.
+ * @return True on success, false on failure.
+ */
+bool write_file_atomic(const char *path, const void *data, size_t len) {
+    if (!make_parent_dirs(path)) return false;
+
+    char tmp_path[1024];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path)) return false;
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if (fp == NULL) {
+        perror("Failed to write file");
+        return false;
+    }
+    size_t written = fwrite(data, 1, len, fp);
+    if (fclose(fp) != 0 || written != len || rename(tmp_path, path) != 0) {
+        perror("Failed to write file");
+        remove(tmp_path);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,10 @@
+#ifndef FS_UTIL_H
+#define FS_UTIL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+bool make_parent_dirs(const char *path);
+bool write_file_atomic(const char *path, const void *data, size_t len);
+
+#endif // FS_UTIL_H
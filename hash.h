@@ -0,0 +1,26 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Seed for a fresh FNV-1a hash. Feed the result back in to hash several pieces.
+#define FNV1A_64_INIT 0xcbf29ce484222325ULL
+
+/**
+ * @brief 64-bit FNV-1a. Tiny and good enough for our short keys (names, EDIDs, modes).
+ * @param data Bytes to hash.
+ * @param len Number of bytes.
+ * @param hash FNV1A_64_INIT, or a previous result to continue hashing.
+ * @return The updated hash.
+ */
+static inline uint64_t fnv1a_64(const void *data, size_t len, uint64_t hash) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+#endif // HASH_H
@@ -0,0 +1,580 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "layout.h"
+#include "hash.h"
+
+/**
+ * @brief Starts an empty layout.
+ */
+void layout_init(Layout *layout) {
+    layout->constraints = NULL;
+    layout->count = 0;
+}
+
+/**
+ * @brief Places an output relative to another, replacing whatever it was placed by before.
+ * @return False if memory ran out.
+ */
+bool layout_set(Layout *layout, const char *output, const char *relation, const char *target) {
+    LayoutConstraint *c = (LayoutConstraint *)layout_find(layout, output);
+    if (c == NULL) {
+        LayoutConstraint *temp = realloc(layout->constraints, (layout->count + 1) * sizeof(LayoutConstraint));
+        if (temp == NULL) {
+            perror("Failed to reallocate memory for layout constraints");
+            return false;
+        }
+        layout->constraints = temp;
+        c = &layout->constraints[layout->count++];
+        snprintf(c->output, sizeof(c->output), "%s", output);
+    }
+    snprintf(c->relation, sizeof(c->relation), "%s", relation);
+    snprintf(c->target, sizeof(c->target), "%s", target);
+    return true;
+}
+
+/**
+ * @brief The constraint that places an output, NULL if it stays where it is.
+ */
+const LayoutConstraint* layout_find(const Layout *layout, const char *output) {
+    for (int i = 0; i < layout->count; i++) {
+        if (strcmp(layout->constraints[i].output, output) == 0) return &layout->constraints[i];
+    }
+    return NULL;
+}
+
+static int find_display(const Display *displays, int count, const char *name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(displays[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief How much of the screen an output takes up when placing things next to it. The
+ * leader of a tiled monitor stands for the whole monitor, as long as it's running as tiles.
+ */
+static PlannedOutput placed_size(const Display *displays, int count, int index, const PlannedOutput *planned) {
+    const Display *d = &displays[index];
+    PlannedOutput p = planned[index];
+    if (d->tile_group == 0 || display_tile_leader(displays, count, d) != d) return p;
+    // The other tiles may only light up once transaction_follow_tiles() has been through
+    bool tile_mode = p.width == d->tile_width && p.height == d->tile_height;
+    for (int i = 0; i < count; i++) {
+        const Display *tile = &displays[i];
+        if (i == index || !tile->connected || tile->tile_group != d->tile_group) continue;
+        if (!planned[i].lit && !tile_mode) continue;
+        if ((tile->tile_column + 1) * planned[index].width > p.width) p.width = (tile->tile_column + 1) * planned[index].width;
+        if ((tile->tile_row + 1) * planned[index].height > p.height) p.height = (tile->tile_row + 1) * planned[index].height;
+    }
+    return p;
+}
+
+/**
+ * @brief Works out where one output goes, placing its target first.
+ * @param state Per display: 0 not placed yet, 1 being placed, 2 done.
+ * @return False on a cycle or an unknown/dark target.
+ */
+static bool place_output(const Layout *layout, const Display *displays, int count, int index,
+                         PlannedOutput *planned, int *state, char *err, size_t err_size) {
+    if (state[index] == 2) return true;
+    if (state[index] == 1) {
+        snprintf(err, err_size, "%s ends up placed relative to itself", displays[index].name);
+        return false;
+    }
+    const LayoutConstraint *c = layout_find(layout, displays[index].name);
+    if (c == NULL) {
+        state[index] = 2; // Anchored where it is
+        return true;
+    }
+
+    int target = find_display(displays, count, c->target);
+    if (target < 0 || !planned[target].lit) {
+        snprintf(err, err_size, "%s is placed relative to %s, which is %s", c->output, c->target,
+                 target < 0 ? "not there" : "off");
+        return false;
+    }
+    state[index] = 1;
+    if (!place_output(layout, displays, count, target, planned, state, err, err_size)) return false;
+    state[index] = 2;
+
+    PlannedOutput *p = &planned[index];
+    PlannedOutput to = placed_size(displays, count, target, planned);
+    PlannedOutput size = placed_size(displays, count, index, planned);
+    p->x_offset = to.x_offset;
+    p->y_offset = to.y_offset;
+    // Edges line up at the top/left, the same as xrandr does it
+    if (strcmp(c->relation, "right-of") == 0) p->x_offset += to.width;
+    else if (strcmp(c->relation, "left-of") == 0) p->x_offset -= size.width;
+    else if (strcmp(c->relation, "below") == 0) p->y_offset += to.height;
+    else if (strcmp(c->relation, "above") == 0) p->y_offset -= size.height;
+    return true;
+}
+
+/**
+ * @brief Adds the planned position of every lit output that moves to a transaction, shifted
+ * so the layout's top-left corner is the origin (xrandr wants non-negative positions).
+ * @return False if memory ran out.
+ */
+static bool add_positions(const PlannedOutput *planned, const Display *displays, int count, Transaction *t) {
+    int min_x = 0, min_y = 0;
+    bool any = false;
+    for (int i = 0; i < count; i++) {
+        if (!planned[i].lit) continue;
+        if (!any || planned[i].x_offset < min_x) min_x = planned[i].x_offset;
+        if (!any || planned[i].y_offset < min_y) min_y = planned[i].y_offset;
+        any = true;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const PlannedOutput *p = &planned[i];
+        int x = p->x_offset - min_x;
+        int y = p->y_offset - min_y;
+        if (!p->lit || (displays[i].is_active && x == displays[i].x_offset && y == displays[i].y_offset)) continue;
+        OutputChange *c = transaction_output(t, displays[i].name);
+        if (c == NULL) return false;
+        c->set_position = 1;
+        c->x_offset = x;
+        c->y_offset = y;
+        c->relation[0] = '\0'; // Absolute wins over whatever was asked before
+    }
+    return true;
+}
+
+/**
+ * @brief Sets an output to a size (and rate, if not 0) through its own modeline.
+ * @return False if the output doesn't have that size or memory ran out.
+ */
+static bool set_common_mode(Transaction *t, const Display *d, const CommonMode *mode) {
+    char name[32];
+    const Mode *m = NULL;
+    snprintf(name, sizeof(name), "%dx%d", mode->width, mode->height);
+    const RefreshRate *r = display_find_rate(d, name, mode->rate, &m);
+    OutputChange *c = r ? transaction_output(t, d->name) : NULL;
+    if (c == NULL) return false;
+    output_change_set_mode(c, m, r);
+    return true;
+}
+
+/**
+ * @brief The output a mirror shows the picture of: the end of its chain of same-as placements.
+ * @return Its index, or -1 if the chain goes round in a circle or ends at an unknown output.
+ */
+static int mirror_root(const Layout *layout, const Display *displays, int count, int index) {
+    for (int hops = 0; hops <= layout->count; hops++) {
+        const LayoutConstraint *c = layout_find(layout, displays[index].name);
+        if (c == NULL || strcmp(c->relation, "same-as") != 0) return index;
+        index = find_display(displays, count, c->target);
+        if (index < 0) return -1;
+    }
+    return -1;
+}
+
+/**
+ * @brief Makes every group of mirrored outputs run one size. The group gets the biggest
+ * mode all of them have, at the highest rate they share. Without one (or when a mode was
+ * picked by hand), mirrors that differ in size are scaled to the size of the output they
+ * show, with --scale-from.
+ * @param planned Sizes as the transaction left them before this.
+ * @return False if memory ran out.
+ */
+static bool mirror_modes(const Layout *layout, const Display *displays, int count, Transaction *t,
+                         const PlannedOutput *planned) {
+    int group[count > 0 ? count : 1];
+    for (int root = 0; root < count; root++) {
+        int n = 0;
+        bool picked = false;
+        group[n++] = root;
+        for (int i = 0; i < count; i++) {
+            if (i != root && planned[i].lit && mirror_root(layout, displays, count, i) == root) group[n++] = i;
+        }
+        if (n == 1 || !planned[root].lit) continue;
+
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < t->output_count; j++) {
+                const OutputChange *c = &t->outputs[j];
+                if (strcmp(c->name, displays[group[i]].name) == 0 && (c->mode[0] != '\0' || c->mode_id != 0)) picked = true;
+            }
+        }
+        CommonMode mode;
+        if (!picked && layout_common_mode(displays, group, n, &mode)) {
+            for (int i = 0; i < n; i++) {
+                if (!set_common_mode(t, &displays[group[i]], &mode)) return false;
+            }
+            continue;
+        }
+
+        for (int i = 1; i < n; i++) {
+            const PlannedOutput *p = &planned[group[i]];
+            if (p->width == planned[root].width && p->height == planned[root].height) continue;
+            if (p->width <= 0 || planned[root].width <= 0) continue; // Size unknown, nothing to scale to
+            OutputChange *c = transaction_output(t, displays[group[i]].name);
+            if (c == NULL) return false;
+            c->scale_from_width = planned[root].width;
+            c->scale_from_height = planned[root].height;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Solves the whole layout into absolute positions and adds them to a transaction,
+ * so everything moves in one xrandr call instead of one per relation.
+ * Outputs without a constraint stay put; dark outputs that are placed get turned on.
+ * Mirrored outputs are brought to one size, see mirror_modes().
+ * @param t Transaction to add to. Mode changes already in it are taken into account.
+ * @param err Filled with the reason if the constraints can't be solved.
+ * @return False if they can't (a cycle, or a target that's off) or memory ran out.
+ */
+bool layout_solve(const Layout *layout, const Display *displays, int count, Transaction *t,
+                  char *err, size_t err_size) {
+    for (int i = 0; i < layout->count; i++) {
+        int index = find_display(displays, count, layout->constraints[i].output);
+        if (index < 0 || displays[index].is_active) continue;
+        OutputChange *c = transaction_output(t, displays[index].name);
+        if (c == NULL) return false;
+        if (c->mode[0] == '\0' && c->mode_id == 0) c->auto_mode = 1;
+    }
+
+    // Sizes (and which outputs are lit) as the transaction leaves them
+    PlannedOutput planned[count > 0 ? count : 1];
+    int state[count > 0 ? count : 1];
+    transaction_plan(t, displays, count, planned);
+    if (!mirror_modes(layout, displays, count, t, planned)) return false;
+    transaction_plan(t, displays, count, planned);
+    memset(state, 0, sizeof(state));
+    for (int i = 0; i < count; i++) {
+        if (planned[i].lit && !place_output(layout, displays, count, i, planned, state, err, err_size)) return false;
+    }
+
+    return add_positions(planned, displays, count, t);
+}
+
+/**
+ * @brief True if two ranges [a, a + a_len) and [b, b + b_len) share at least one pixel.
+ */
+static bool ranges_overlap(int a, int a_len, int b, int b_len) {
+    return a < b + b_len && b < a + a_len;
+}
+
+/**
+ * @brief Reads the current arrangement back as placements: an output whose left edge
+ * touches another's right edge is right of it, one whose top edge touches another's bottom
+ * is below it, and one exactly on top of another is the same as it. Outputs that touch
+ * nothing to their left or above stay anchored. Placements only ever point left, up or to an
+ * earlier output, so they can't go round in a circle.
+ * @return False if memory ran out.
+ */
+static bool infer_layout(Layout *layout, const Display *displays, int count) {
+    for (int i = 0; i < count; i++) {
+        const Display *d = &displays[i];
+        if (!d->is_active) continue;
+        const char *relation = NULL;
+        int target = -1;
+        for (int j = 0; j < count && relation == NULL; j++) {
+            const Display *o = &displays[j];
+            if (j == i || !o->is_active) continue;
+            if (j < i && d->x_offset == o->x_offset && d->y_offset == o->y_offset &&
+                d->width == o->width && d->height == o->height) {
+                relation = "same-as";
+            } else if (d->x_offset == o->x_offset + o->width &&
+                       ranges_overlap(d->y_offset, d->height, o->y_offset, o->height)) {
+                relation = "right-of";
+            } else if (d->y_offset == o->y_offset + o->height &&
+                       ranges_overlap(d->x_offset, d->width, o->x_offset, o->width)) {
+                relation = "below";
+            }
+            target = j;
+        }
+        if (relation && !layout_set(layout, d->name, relation, displays[target].name)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Scales every lit output so things come out the same physical size on all of them:
+ * each gets as many screen pixels per inch as the primary output (or the first lit one) has.
+ * Scales are rounded to eighths, and outputs that are within 5% are left alone. Outputs that
+ * touched keep touching, see infer_layout(), so the new scales and positions go out together.
+ * @param err Filled with the reason if there's nothing to go by.
+ * @return False if no lit output has a known physical size, the layout can't be solved, or
+ * memory ran out.
+ */
+bool layout_normalize_dpi(const Display *displays, int count, Transaction *t, char *err, size_t err_size) {
+    int reference = -1;
+    for (int i = 0; i < count; i++) {
+        if (display_dpi(&displays[i]) <= 0.0) continue;
+        if (reference < 0 || (displays[i].is_primary && !displays[reference].is_primary)) reference = i;
+    }
+    if (reference < 0) {
+        snprintf(err, err_size, "No lit output reports its physical size");
+        return false;
+    }
+
+    // Screen pixels per inch on the reference, as it's scaled now
+    const Display *ref = &displays[reference];
+    double target = display_dpi(ref) * (ref->scale > 0.0 ? ref->scale : 1.0);
+    for (int i = 0; i < count; i++) {
+        double dpi = display_dpi(&displays[i]);
+        if (i == reference || dpi <= 0.0) continue;
+        double scale = (int)(target / dpi * 8.0 + 0.5) / 8.0;
+        double current = displays[i].scale > 0.0 ? displays[i].scale : 1.0;
+        if (scale < 0.125) scale = 0.125;
+        if (scale / current > 0.95 && scale / current < 1.05) continue;
+        OutputChange *c = transaction_output(t, displays[i].name);
+        if (c == NULL) return false;
+        c->scale = scale;
+    }
+
+    Layout layout;
+    layout_init(&layout);
+    bool ok = infer_layout(&layout, displays, count) && layout_solve(&layout, displays, count, t, err, err_size);
+    layout_free(&layout);
+    return ok;
+}
+
+/**
+ * @brief Frees the memory held by a layout and leaves it empty.
+ */
+void layout_free(Layout *layout) {
+    free(layout->constraints);
+    layout_init(layout);
+}
+
+/**
+ * @brief One mode size (or rate) in the table layout_common_mode() counts with.
+ */
+typedef struct {
+    uint64_t key;
+    int used;
+    int width, height;
+    int centi_hz; // 0 for size entries
+    int outputs;  // How many outputs of the group have it
+    int last;     // Last output counted, so duplicates within one output count once
+} ModeKeyEntry;
+
+/**
+ * @brief Counts a key for one output in an open-addressing table.
+ * @return The entry, so the caller can fill in what the key stands for.
+ */
+static ModeKeyEntry* count_mode_key(ModeKeyEntry *table, int capacity, uint64_t key, int output) {
+    int slot = (int)(key & (uint64_t)(capacity - 1));
+    while (table[slot].used && table[slot].key != key) slot = (slot + 1) & (capacity - 1);
+    ModeKeyEntry *e = &table[slot];
+    if (!e->used) {
+        e->used = 1;
+        e->key = key;
+        e->last = -1;
+    }
+    if (e->last != output) {
+        e->outputs++;
+        e->last = output;
+    }
+    return e;
+}
+
+/**
+ * @brief Finds the biggest progressive mode all outputs of a group have, and the highest
+ * rate they all have at that size. Sizes and rates are hashed into one table, so this
+ * stays linear in the number of modes however many outputs there are.
+ * @param outputs Indices into displays (their modes have to be decoded).
+ * @return False if there's no mode they all have.
+ */
+bool layout_common_mode(const Display *displays, const int *outputs, int n, CommonMode *mode) {
+    memset(mode, 0, sizeof(CommonMode));
+    int total = 0;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < displays[outputs[i]].mode_count; j++) total += 1 + displays[outputs[i]].modes[j].rate_count;
+    }
+    if (n == 0 || total == 0) return false;
+    int capacity = 16;
+    while (capacity < total * 2) capacity *= 2;
+    ModeKeyEntry *table = calloc(capacity, sizeof(ModeKeyEntry));
+    if (table == NULL) {
+        perror("Failed to allocate mode table");
+        return false;
+    }
+
+    for (int i = 0; i < n; i++) {
+        const Display *d = &displays[outputs[i]];
+        for (int j = 0; j < d->mode_count; j++) {
+            const Mode *m = &d->modes[j];
+            if (m->interlaced || m->doublescan || m->width <= 0) continue;
+            int size[2] = {m->width, m->height};
+            uint64_t size_key = fnv1a_64(size, sizeof(size), FNV1A_64_INIT);
+            ModeKeyEntry *e = count_mode_key(table, capacity, size_key, i);
+            e->width = m->width;
+            e->height = m->height;
+            if (e->outputs == n && (long)m->width * m->height > (long)mode->width * mode->height) {
+                mode->width = m->width;
+                mode->height = m->height;
+            }
+            // Rates to the hundredth of a Hz, like xrandr prints them
+            for (int k = 0; k < m->rate_count; k++) {
+                int centi_hz = (int)(m->refresh_rates[k].rate * 100.0 + 0.5);
+                uint64_t rate_key = fnv1a_64(&centi_hz, sizeof(centi_hz), size_key);
+                e = count_mode_key(table, capacity, rate_key, i);
+                e->width = m->width;
+                e->height = m->height;
+                e->centi_hz = centi_hz;
+            }
+        }
+    }
+
+    // A rate counts only once the whole group is in; the size was picked above
+    for (int i = 0; i < capacity && mode->width > 0; i++) {
+        const ModeKeyEntry *e = &table[i];
+        if (e->used && e->centi_hz > 0 && e->outputs == n && e->width == mode->width &&
+            e->height == mode->height && e->centi_hz / 100.0 > mode->rate) {
+            mode->rate = e->centi_hz / 100.0;
+        }
+    }
+    free(table);
+    return mode->width > 0;
+}
+
+/**
+ * @brief Lays out a video wall: every output gets the biggest mode they all have and its
+ * place in the grid, with gaps for the bezels. All of it goes into one transaction.
+ * The wall's top-left panel sits at the origin; outputs not in it aren't touched.
+ * @param outputs Indices into displays, in wall order (modes have to be decoded).
+ * @param mode Filled with the mode the panels get.
+ * @param err Filled with the reason if the wall can't be built.
+ * @return False if it can't (too many outputs for the grid, no common mode) or memory ran out.
+ */
+bool layout_grid(const GridSpec *grid, const Display *displays, const int *outputs, int n,
+                 Transaction *t, CommonMode *mode, char *err, size_t err_size) {
+    if (n == 0 || grid->rows <= 0 || grid->columns <= 0 || n > grid->rows * grid->columns) {
+        snprintf(err, err_size, "%d outputs don't fit a %dx%d wall", n, grid->rows, grid->columns);
+        return false;
+    }
+    if (!layout_common_mode(displays, outputs, n, mode)) {
+        snprintf(err, err_size, "The outputs have no mode in common");
+        return false;
+    }
+
+    // Panels keep their rotation, so portrait walls get portrait cells
+    bool sideways = rotation_is_sideways(displays[outputs[0]].rotation);
+    int cell_width = sideways ? mode->height : mode->width;
+    int cell_height = sideways ? mode->width : mode->height;
+    for (int i = 0; i < n; i++) {
+        const Display *d = &displays[outputs[i]];
+        int row = grid->order == GRID_ROWS_FIRST ? i / grid->columns : i % grid->rows;
+        int column = grid->order == GRID_ROWS_FIRST ? i % grid->columns : i / grid->rows;
+        if (!set_common_mode(t, d, mode)) return false;
+        OutputChange *c = transaction_output(t, d->name);
+        if (c == NULL) return false;
+        c->set_position = 1;
+        c->x_offset = column * (cell_width + grid->bezel_x);
+        c->y_offset = row * (cell_height + grid->bezel_y);
+        if (rotation_is_sideways(d->rotation) != sideways) {
+            // Mixed orientations would overlap, so the whole wall takes the first panel's
+            c->set_rotation = 1;
+            c->rotation = (d->rotation & REFLECT_MASK) | (displays[outputs[0]].rotation & ROTATION_MASK);
+        }
+        c->relation[0] = '\0';
+    }
+    return true;
+}
+
+/**
+ * @brief Starts the layout map on the current positions.
+ * @param base Changes still waiting to be applied (scales, rotations), so every output is shown
+ * at the logical size it's going to have; NULL if there are none.
+ * @param selected Index of the display to move first (the next lit one if it's dark).
+ * @return False if memory ran out.
+ */
+bool layout_map_init(LayoutMap *map, const Transaction *base, const Display *displays, int count, int selected) {
+    Transaction none;
+    transaction_init(&none);
+    map->planned = malloc((count > 0 ? count : 1) * sizeof(PlannedOutput));
+    if (map->planned == NULL) {
+        perror("Failed to allocate layout map");
+        return false;
+    }
+    transaction_plan(base ? base : &none, displays, count, map->planned);
+    map->count = count;
+    map->selected = selected >= 0 && selected < count ? selected : 0;
+    map->step = 10;
+    map->snap = true;
+    if (count > 0 && !map->planned[map->selected].lit) layout_map_select_next(map);
+    return true;
+}
+
+/**
+ * @brief Moves the selection to the next lit output.
+ */
+void layout_map_select_next(LayoutMap *map) {
+    for (int i = 1; i <= map->count; i++) {
+        int index = (map->selected + i) % map->count;
+        if (map->planned[index].lit) {
+            map->selected = index;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief How far an edge can go towards the next edge of another output, for snapping.
+ * @param from Positions of the moving output's two edges on this axis.
+ * @param delta Wanted move, positive or negative.
+ * @return The move, cut short at the first other edge it would reach or cross.
+ */
+static int snap_move(const LayoutMap *map, bool horizontal, const int from[2], int delta) {
+    int move = delta;
+    for (int i = 0; i < map->count; i++) {
+        const PlannedOutput *o = &map->planned[i];
+        if (i == map->selected || !o->lit) continue;
+        int edges[2] = {horizontal ? o->x_offset : o->y_offset,
+                        horizontal ? o->x_offset + o->width : o->y_offset + o->height};
+        for (int a = 0; a < 2; a++) {
+            for (int b = 0; b < 2; b++) {
+                int gap = edges[b] - from[a];
+                // Only edges ahead, and not the one we're already sitting on
+                if (delta > 0 && gap > 0 && gap < move) move = gap;
+                if (delta < 0 && gap < 0 && gap > move) move = gap;
+            }
+        }
+    }
+    return move;
+}
+
+/**
+ * @brief Moves the selected output by whole steps. With snapping on, it stops at any edge
+ * of another output on the way, so outputs line up without counting pixels.
+ * @param dx Steps to the right (negative: left).
+ * @param dy Steps down (negative: up).
+ */
+void layout_map_nudge(LayoutMap *map, int dx, int dy) {
+    if (map->count == 0) return;
+    PlannedOutput *p = &map->planned[map->selected];
+    int move_x = dx * map->step;
+    int move_y = dy * map->step;
+    if (map->snap && move_x != 0) {
+        int from[2] = {p->x_offset, p->x_offset + p->width};
+        move_x = snap_move(map, true, from, move_x);
+    }
+    if (map->snap && move_y != 0) {
+        int from[2] = {p->y_offset, p->y_offset + p->height};
+        move_y = snap_move(map, false, from, move_y);
+    }
+    p->x_offset += move_x;
+    p->y_offset += move_y;
+}
+
+/**
+ * @brief Adds the moved positions to a transaction, to go out as one apply.
+ * @return False if memory ran out.
+ */
+bool layout_map_commit(const LayoutMap *map, const Display *displays, int count, Transaction *t) {
+    return add_positions(map->planned, displays, count < map->count ? count : map->count, t);
+}
+
+/**
+ * @brief Frees the positions held by the map.
+ */
+void layout_map_free(LayoutMap *map) {
+    free(map->planned);
+    map->planned = NULL;
+    map->count = 0;
+}
@@ -0,0 +1,78 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "xrandr_parser.h"
+#include "xrandr_apply.h"
+
+/**
+ * @brief "Put output next to target", as picked in the position panel.
+ */
+typedef struct {
+    char output[32];
+    char relation[16]; // right-of, left-of, above, below, same-as
+    char target[32];
+} LayoutConstraint;
+
+/**
+ * @brief A set of relative placements, at most one per output, that is solved into
+ * absolute positions as a whole.
+ */
+typedef struct {
+    LayoutConstraint *constraints;
+    int count;
+} Layout;
+
+/**
+ * @brief Positions being moved around on the layout map, before they're applied.
+ */
+typedef struct {
+    PlannedOutput *planned; // One per display, see transaction_plan()
+    int count;
+    int selected;           // Index of the display being moved
+    int step;               // Pixels per key press
+    bool snap;              // Stop at the edges of the other outputs
+} LayoutMap;
+
+/**
+ * @brief A mode every output in a group has, see layout_common_mode().
+ */
+typedef struct {
+    int width, height;
+    double rate; // Highest rate they all have, 0 if there isn't one (each keeps its preferred)
+} CommonMode;
+
+typedef enum {
+    GRID_ROWS_FIRST,   // Outputs fill the first row left to right, then the next row
+    GRID_COLUMNS_FIRST // Outputs fill the first column top to bottom, then the next column
+} GridOrder;
+
+/**
+ * @brief A video wall: identical panels in rows and columns.
+ */
+typedef struct {
+    int rows, columns;
+    int bezel_x, bezel_y; // Pixels hidden behind the bezels between two panels
+    GridOrder order;
+} GridSpec;
+
+void layout_init(Layout *layout);
+bool layout_set(Layout *layout, const char *output, const char *relation, const char *target);
+const LayoutConstraint* layout_find(const Layout *layout, const char *output);
+bool layout_solve(const Layout *layout, const Display *displays, int count, Transaction *t,
+                  char *err, size_t err_size);
+void layout_free(Layout *layout);
+bool layout_normalize_dpi(const Display *displays, int count, Transaction *t, char *err, size_t err_size);
+
+bool layout_common_mode(const Display *displays, const int *outputs, int n, CommonMode *mode);
+bool layout_grid(const GridSpec *grid, const Display *displays, const int *outputs, int n,
+                 Transaction *t, CommonMode *mode, char *err, size_t err_size);
+
+bool layout_map_init(LayoutMap *map, const Transaction *base, const Display *displays, int count, int selected);
+void layout_map_select_next(LayoutMap *map);
+void layout_map_nudge(LayoutMap *map, int dx, int dy);
+bool layout_map_commit(const LayoutMap *map, const Display *displays, int count, Transaction *t);
+void layout_map_free(LayoutMap *map);
+
+#endif // LAYOUT_H
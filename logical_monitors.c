@@ -0,0 +1,292 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logical_monitors.h"
+
+/**
+ * @brief Parses the output of xrandr --listmonitors, e.g.
+ * "Monitors: 2" followed by " 0: +*eDP-1 1920/309x1080/174+0+360  eDP-1" for each one.
+ * '+' marks a monitor the server made for an output, '*' the primary one; the outputs come last.
+ * @param fp Stream to read from.
+ * @param count Filled with the number of monitors found.
+ * @return A malloc'd array (free it), or NULL if there are none or memory ran out.
+ */
+LogicalMonitor* parse_logical_monitors_stream(FILE *fp, int *count) {
+    *count = 0;
+    LogicalMonitor *monitors = NULL;
+    char line[512];
+
+    while (fgets(line, sizeof(line), fp)) {
+        LogicalMonitor m;
+        char name[80];
+        int used = 0;
+        memset(&m, 0, sizeof(LogicalMonitor));
+        if (sscanf(line, "%d: %79s %d/%dx%d/%d%d%d%n", &m.index, name, &m.width, &m.width_mm, &m.height,
+                   &m.height_mm, &m.x_offset, &m.y_offset, &used) != 8) {
+            continue;
+        }
+        const char *p = name;
+        for (; *p == '+' || *p == '*'; p++) {
+            if (*p == '+') m.automatic = true;
+            else m.primary = true;
+        }
+        snprintf(m.name, sizeof(m.name), "%.63s", p);
+
+        char output[64];
+        size_t len = 0;
+        int skip;
+        for (const char *rest = line + used; sscanf(rest, "%63s%n", output, &skip) == 1; rest += skip) {
+            len += snprintf(m.outputs + len, sizeof(m.outputs) - len, "%s%s", len ? "," : "", output);
+            if (len >= sizeof(m.outputs)) break;
+        }
+
+        LogicalMonitor *temp = realloc(monitors, (*count + 1) * sizeof(LogicalMonitor));
+        if (temp == NULL) {
+            perror("Failed to reallocate memory for monitors");
+            free(monitors);
+            *count = 0;
+            return NULL;
+        }
+        monitors = temp;
+        monitors[(*count)++] = m;
+    }
+    return monitors;
+}
+
+/**
+ * @brief Runs xrandr --listmonitors and parses it.
+ * @param count Filled with the number of monitors found.
+ * @return Same as parse_logical_monitors_stream().
+ */
+LogicalMonitor* read_logical_monitors(int *count) {
+    *count = 0;
+    FILE *fp = popen("xrandr --listmonitors", "r");
+    if (fp == NULL) {
+        perror("Failed to run xrandr command");
+        return NULL;
+    }
+    LogicalMonitor *monitors = parse_logical_monitors_stream(fp, count);
+    pclose(fp);
+    return monitors;
+}
+
+/**
+ * @brief Looks a monitor up by name.
+ * @return The monitor, or NULL if there is no such one.
+ */
+const LogicalMonitor* logical_monitor_find(const LogicalMonitor *monitors, int count, const char *name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(monitors[i].name, name) == 0) return &monitors[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief True if an output is one of the monitor's.
+ */
+bool logical_monitor_uses(const LogicalMonitor *monitor, const char *output) {
+    size_t len = strlen(output);
+    for (const char *p = monitor->outputs; *p; p += strcspn(p, ",") + (p[strcspn(p, ",")] == ',')) {
+        if (strncmp(p, output, len) == 0 && (p[len] == ',' || p[len] == '\0')) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Works out a monitor's physical size from the pixels per millimetre of its first output
+ * that reports one, so windows keep the right DPI on it. Without one, it goes by 96 DPI.
+ */
+void logical_monitor_physical_size(const Display *displays, int count, LogicalMonitor *monitor) {
+    for (int i = 0; i < count; i++) {
+        const Display *d = &displays[i];
+        if (d->width <= 0 || d->height <= 0 || d->width_mm <= 0 || !logical_monitor_uses(monitor, d->name)) continue;
+        monitor->width_mm = (int)((double)monitor->width * d->width_mm / d->width + 0.5);
+        monitor->height_mm = (int)((double)monitor->height * d->height_mm / d->height + 0.5);
+        return;
+    }
+    monitor->width_mm = (int)(monitor->width * 25.4 / 96.0 + 0.5);
+    monitor->height_mm = (int)(monitor->height * 25.4 / 96.0 + 0.5);
+}
+
+/**
+ * @brief Adds a monitor to a transaction as it's described, creating it or replacing the
+ * one with the same name.
+ * @return False if memory ran out.
+ */
+bool logical_monitor_set(Transaction *t, const LogicalMonitor *monitor) {
+    MonitorChange *c = transaction_monitor(t, monitor->name);
+    if (c == NULL) return false;
+    c->remove = 0;
+    c->width = monitor->width;
+    c->height = monitor->height;
+    c->width_mm = monitor->width_mm;
+    c->height_mm = monitor->height_mm;
+    c->x_offset = monitor->x_offset;
+    c->y_offset = monitor->y_offset;
+    snprintf(c->outputs, sizeof(c->outputs), "%s", monitor->outputs);
+    return true;
+}
+
+/**
+ * @brief Splits an output into side-by-side monitors of (nearly) the same width, named
+ * "OUT:1", "OUT:2" and so on, from where the transaction leaves the output. The first one
+ * takes the output, which makes the server drop the automatic monitor for it. Parts left
+ * over from an earlier split into more are deleted; a single part undoes the split.
+ * @param output Index of the output in displays.
+ * @param planned Where the transaction leaves each display, see transaction_plan().
+ * @return False if memory ran out.
+ */
+bool logical_monitors_split(Transaction *t, const LogicalMonitor *monitors, int count, const Display *displays,
+                            int display_count, int output, const PlannedOutput *planned, int parts) {
+    const Display *d = &displays[output];
+    const PlannedOutput *p = &planned[output];
+    char prefix[40];
+    int prefix_len = snprintf(prefix, sizeof(prefix), "%s:", d->name);
+    for (int i = 0; i < count; i++) {
+        const char *name = monitors[i].name;
+        if (strncmp(name, prefix, prefix_len) != 0 || (parts > 1 && atoi(name + prefix_len) <= parts)) continue;
+        MonitorChange *c = transaction_monitor(t, name);
+        if (c == NULL) return false;
+        c->remove = 1;
+    }
+    if (parts <= 1 || !p->lit) return true;
+
+    for (int k = 0; k < parts; k++) {
+        LogicalMonitor m;
+        memset(&m, 0, sizeof(LogicalMonitor));
+        snprintf(m.name, sizeof(m.name), "%s%d", prefix, k + 1);
+        m.x_offset = p->x_offset + k * (p->width / parts);
+        m.y_offset = p->y_offset;
+        m.width = k == parts - 1 ? p->width - k * (p->width / parts) : p->width / parts;
+        m.height = p->height;
+        if (k == 0) snprintf(m.outputs, sizeof(m.outputs), "%s", d->name);
+        if (d->width_mm > 0 && d->height_mm > 0) {
+            // The output's physical size goes with the size it's planned at, not the current one
+            m.width_mm = (int)((double)m.width * d->width_mm / p->width + 0.5);
+            m.height_mm = (int)((double)m.height * d->height_mm / p->height + 0.5);
+        } else {
+            logical_monitor_physical_size(displays, display_count, &m);
+        }
+        if (!logical_monitor_set(t, &m)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Adds whatever turns one list of monitors into the other: deletes for the ones that
+ * are gone, and the new or changed ones. Automatic monitors are the server's and are left alone.
+ * @return False if memory ran out.
+ */
+bool logical_monitors_diff(const LogicalMonitor *before, int before_count, const LogicalMonitor *after,
+                           int after_count, Transaction *t) {
+    for (int i = 0; i < before_count; i++) {
+        if (before[i].automatic || logical_monitor_find(after, after_count, before[i].name)) continue;
+        MonitorChange *c = transaction_monitor(t, before[i].name);
+        if (c == NULL) return false;
+        c->remove = 1;
+    }
+    for (int i = 0; i < after_count; i++) {
+        const LogicalMonitor *m = &after[i];
+        const LogicalMonitor *was = logical_monitor_find(before, before_count, m->name);
+        if (m->automatic) continue;
+        if (was && !was->automatic && was->x_offset == m->x_offset && was->y_offset == m->y_offset &&
+            was->width == m->width && was->height == m->height && strcmp(was->outputs, m->outputs) == 0) {
+            continue;
+        }
+        if (!logical_monitor_set(t, m)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Splits a monitor into a left and a right half, in a list being edited. The left half
+ * keeps the outputs; an automatic monitor becomes one made by hand, named like split's parts.
+ * The right half gets the first free "BASE:N" name, BASE being the first output (or the name).
+ * @return False if the monitor is too narrow or memory ran out.
+ */
+bool logical_monitors_halve(LogicalMonitor **monitors, int *count, int index) {
+    LogicalMonitor m = (*monitors)[index];
+    if (m.width < 2) return false;
+    LogicalMonitor *temp = realloc(*monitors, (*count + 1) * sizeof(LogicalMonitor));
+    if (temp == NULL) {
+        perror("Failed to reallocate memory for monitors");
+        return false;
+    }
+    *monitors = temp;
+
+    char base[64];
+    snprintf(base, sizeof(base), "%.*s", (int)strcspn(m.outputs[0] ? m.outputs : m.name, ","),
+             m.outputs[0] ? m.outputs : m.name);
+    LogicalMonitor *left = &temp[index];
+    if (left->automatic) snprintf(left->name, sizeof(left->name), "%.40s:1", base);
+    left->automatic = false;
+    left->width = m.width / 2;
+    left->width_mm = m.width_mm / 2;
+
+    LogicalMonitor right = m;
+    right.automatic = false;
+    right.primary = false;
+    right.x_offset = m.x_offset + left->width;
+    right.width = m.width - left->width;
+    right.width_mm = m.width_mm - left->width_mm;
+    right.outputs[0] = '\0';
+    for (int n = 2; ; n++) {
+        snprintf(right.name, sizeof(right.name), "%.40s:%d", base, n);
+        if (logical_monitor_find(temp, *count, right.name) == NULL) break;
+    }
+    memmove(&temp[index + 2], &temp[index + 1], (*count - index - 1) * sizeof(LogicalMonitor));
+    temp[index + 1] = right;
+    (*count)++;
+    return true;
+}
+
+/**
+ * @brief Moves a monitor's right edge by dx pixels, in a list being edited. A monitor made by
+ * hand whose left edge was on that line moves along, so a split's divider slides.
+ * @return False for automatic monitors (the server sizes those) or if either would vanish.
+ */
+bool logical_monitors_widen(LogicalMonitor *monitors, int count, int index, int dx) {
+    LogicalMonitor *m = &monitors[index];
+    LogicalMonitor *next = NULL;
+    for (int i = 0; i < count; i++) {
+        const LogicalMonitor *o = &monitors[i];
+        if (i != index && !o->automatic && o->x_offset == m->x_offset + m->width && o->y_offset == m->y_offset) {
+            next = &monitors[i];
+        }
+    }
+    if (m->automatic || m->width + dx < 1 || (next && next->width - dx < 1)) return false;
+    double mm_per_pixel = m->width > 0 ? (double)m->width_mm / m->width : 0.0;
+    m->width += dx;
+    m->width_mm = (int)(m->width * mm_per_pixel + 0.5);
+    if (next) {
+        mm_per_pixel = next->width > 0 ? (double)next->width_mm / next->width : 0.0;
+        next->x_offset += dx;
+        next->width -= dx;
+        next->width_mm = (int)(next->width * mm_per_pixel + 0.5);
+    }
+    return true;
+}
+
+/**
+ * @brief Drops a monitor from a list being edited.
+ */
+void logical_monitors_remove(LogicalMonitor *monitors, int *count, int index) {
+    memmove(&monitors[index], &monitors[index + 1], (*count - index - 1) * sizeof(LogicalMonitor));
+    (*count)--;
+}
+
+/**
+ * @brief Prints the monitors in the same style as fprint_displays().
+ */
+void fprint_logical_monitors(FILE *out, const LogicalMonitor *monitors, int count) {
+    for (int i = 0; i < count; i++) {
+        const LogicalMonitor *m = &monitors[i];
+        fprintf(out, "\nMonitor #%d: %s (%s%s)\n", m->index, m->name, m->automatic ? "automatic" : "defined",
+                m->primary ? ", primary" : "");
+        fprintf(out, "  Geometry: %dx%d+%d+%d, %dx%d mm\n", m->width, m->height, m->x_offset, m->y_offset,
+                m->width_mm, m->height_mm);
+        fprintf(out, "  Outputs: %s\n", m->outputs[0] ? m->outputs : "none");
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef LOGICAL_MONITORS_H
+#define LOGICAL_MONITORS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "xrandr_parser.h"
+#include "xrandr_apply.h"
+
+/**
+ * @brief A RandR 1.5 monitor, from xrandr --listmonitors: the area window managers and
+ * toolkits treat as one screen. The server makes one per lit output (automatic ones); more
+ * can be defined by hand, e.g. to split an ultrawide into two.
+ */
+typedef struct {
+    int index;            // Position in the list, as xrandr numbers them
+    char name[64];        // e.g. "eDP-1" for an automatic one, anything for the others
+    bool automatic;       // '+': made by the server for an output, goes away with it
+    bool primary;         // '*'
+    int width, height;
+    int width_mm, height_mm;
+    int x_offset, y_offset;
+    char outputs[128];    // Comma separated, as --setmonitor takes them; "" if none
+} LogicalMonitor;
+
+LogicalMonitor* parse_logical_monitors_stream(FILE *fp, int *count);
+LogicalMonitor* read_logical_monitors(int *count);
+const LogicalMonitor* logical_monitor_find(const LogicalMonitor *monitors, int count, const char *name);
+bool logical_monitor_uses(const LogicalMonitor *monitor, const char *output);
+void logical_monitor_physical_size(const Display *displays, int count, LogicalMonitor *monitor);
+bool logical_monitor_set(Transaction *t, const LogicalMonitor *monitor);
+bool logical_monitors_split(Transaction *t, const LogicalMonitor *monitors, int count, const Display *displays,
+                            int display_count, int output, const PlannedOutput *planned, int parts);
+bool logical_monitors_diff(const LogicalMonitor *before, int before_count, const LogicalMonitor *after,
+                           int after_count, Transaction *t);
+bool logical_monitors_halve(LogicalMonitor **monitors, int *count, int index);
+bool logical_monitors_widen(LogicalMonitor *monitors, int count, int index, int dx);
+void logical_monitors_remove(LogicalMonitor *monitors, int *count, int index);
+void fprint_logical_monitors(FILE *out, const LogicalMonitor *monitors, int count);
+
+#endif // LOGICAL_MONITORS_H
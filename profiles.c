@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "profiles.h"
+#include "hash.h"
+#include "fs_util.h"
+#include "edid.h"
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Hashes the set of connected outputs, independent of the order xrandr lists them in.
+ * @param displays An array of Display structs.
+ * @param count The number of displays in the array.
+ * @return The fingerprint (0 if nothing is connected).
+ */
+uint64_t monitor_set_fingerprint(const Display *displays, int count) {
+    uint64_t ids[count > 0 ? count : 1];
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (displays[i].connected) {
+            ids[n++] = display_identity(&displays[i]);
+        }
+    }
+    if (n == 0) return 0;
+
+    qsort(ids, n, sizeof(uint64_t), compare_u64);
+    return fnv1a_64(ids, n * sizeof(uint64_t), FNV1A_64_INIT);
+}
+
+/**
+ * @brief Rebuilds the fingerprint index after profiles were added or loaded.
+ */
+static bool rebuild_index(ProfileStore *store) {
+    int capacity = 8;
+    while (capacity < store->count * 2) capacity *= 2;
+
+    int *slots = malloc(capacity * sizeof(int));
+    if (slots == NULL) {
+        perror("Failed to allocate profile index");
+        return false;
+    }
+    memset(slots, -1, capacity * sizeof(int));
+
+    for (int i = 0; i < store->count; i++) {
+        int slot = (int)(store->profiles[i].fingerprint & (uint64_t)(capacity - 1));
+        while (slots[slot] != -1) slot = (slot + 1) & (capacity - 1);
+        slots[slot] = i;
+    }
+
+    free(store->slots);
+    store->slots = slots;
+    store->capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief Works out where profiles live: $XDG_CONFIG_HOME/myrandr/profiles or ~/.config/myrandr/profiles.
+ * @return buf, or NULL if neither variable is set.
+ */
+const char* profile_store_default_path(char *buf, size_t size) {
+    const char *xdg = getenv("XDG_CONFIG_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && xdg[0] != '\0') {
+        snprintf(buf, size, "%s/myrandr/profiles", xdg);
+    } else if (home && home[0] != '\0') {
+        snprintf(buf, size, "%s/.config/myrandr/profiles", home);
+    } else {
+        return NULL;
+    }
+    return buf;
+}
+
+/**
+ * @brief Appends a blank profile to the store.
+ */
+static Profile* add_profile(ProfileStore *store) {
+    Profile *temp = realloc(store->profiles, (store->count + 1) * sizeof(Profile));
+    if (temp == NULL) {
+        perror("Failed to reallocate memory for profiles");
+        return NULL;
+    }
+    store->profiles = temp;
+    Profile *p = &store->profiles[store->count++];
+    memset(p, 0, sizeof(Profile));
+    return p;
+}
+
+static ProfileOutput* add_profile_output(Profile *p) {
+    ProfileOutput *temp = realloc(p->outputs, (p->output_count + 1) * sizeof(ProfileOutput));
+    if (temp == NULL) {
+        perror("Failed to reallocate memory for profile outputs");
+        return NULL;
+    }
+    p->outputs = temp;
+    ProfileOutput *o = &p->outputs[p->output_count++];
+    memset(o, 0, sizeof(ProfileOutput));
+    return o;
+}
+
+/**
+ * @brief Loads the profile store. A missing file just means no profiles yet.
+ *
+ * The format is plain text, one record per line:
+ *   profile <fingerprint-hex> <name>
+ *   output <name> <on|off> <width>x<height> <rate> <x> <y> <primary> [identity-hex [mode-name [rotation-hex [scale]]]]
+ * The size is what the output covers on the screen, so it's already rotated.
+ *
+ * @param store The store to fill.
+ * @param path File to read, or NULL for profile_store_default_path().
+ * @return True on success, false on failure.
+ */
+bool profile_store_load(ProfileStore *store, const char *path) {
+    memset(store, 0, sizeof(ProfileStore));
+    if (path) {
+        snprintf(store->path, sizeof(store->path), "%s", path);
+    } else if (!profile_store_default_path(store->path, sizeof(store->path))) {
+        return rebuild_index(store);
+    }
+
+    FILE *fp = fopen(store->path, "r");
+    if (fp == NULL) {
+        return rebuild_index(store);
+    }
+
+    char line[256];
+    Profile *current = NULL;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), fp) != NULL) {
+        if (strncmp(line, "profile ", 8) == 0) {
+            uint64_t fingerprint;
+            char name[64];
+            if (sscanf(line, "profile %" SCNx64 " %63s", &fingerprint, name) != 2) {
+                current = NULL;
+                continue;
+            }
+            current = add_profile(store);
+            if (current == NULL) { ok = false; break; }
+            current->fingerprint = fingerprint;
+            snprintf(current->name, sizeof(current->name), "%s", name);
+        } else if (current && strncmp(line, "output ", 7) == 0) {
+            ProfileOutput o;
+            char state[4];
+            memset(&o, 0, sizeof(o));
+            if (sscanf(line, "output %31s %3s %dx%d %lf %d %d %d %" SCNx64 " %31s %x %lf", o.name, state, &o.width, &o.height,
+                       &o.rate, &o.x_offset, &o.y_offset, &o.primary, &o.identity, o.mode, &o.rotation, &o.scale) < 8) {
+                continue; // Skip lines we don't understand rather than failing the whole store
+            }
+            o.enabled = strcmp(state, "on") == 0;
+            ProfileOutput *slot = add_profile_output(current);
+            if (slot == NULL) { ok = false; break; }
+            *slot = o;
+        }
+    }
+    fclose(fp);
+
+    return ok && rebuild_index(store);
+}
+
+/**
+ * @brief Writes the store back to its file, creating the directory if needed.
+ * @return True on success, false on failure.
+ */
+bool profile_store_save(const ProfileStore *store) {
+    if (store->path[0] == '\0') return false;
+
+    if (!make_parent_dirs(store->path)) {
+        return false;
+    }
+
+    // Write to a temp file and rename, so a crash never leaves half a store behind.
+    char tmp_path[sizeof(store->path) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", store->path);
+    FILE *fp = fopen(tmp_path, "w");
+    if (fp == NULL) {
+        perror("Failed to write profiles");
+        return false;
+    }
+
+    fprintf(fp, "# myrandr profiles\n");
+    for (int i = 0; i < store->count; i++) {
+        const Profile *p = &store->profiles[i];
+        fprintf(fp, "profile %016" PRIx64 " %s\n", p->fingerprint, p->name);
+        for (int j = 0; j < p->output_count; j++) {
+            const ProfileOutput *o = &p->outputs[j];
+            fprintf(fp, "output %s %s %dx%d %.3f %d %d %d %016" PRIx64 "%s%s", o->name, o->enabled ? "on" : "off",
+                    o->width, o->height, o->rate, o->x_offset, o->y_offset, o->primary, o->identity,
+                    o->mode[0] ? " " : "", o->mode);
+            // These can only follow a mode name, which every lit output has
+            if (o->mode[0] && o->rotation != 0) {
+                fprintf(fp, " %x", o->rotation);
+                if (o->scale > 0.0) fprintf(fp, " %.3f", o->scale);
+            }
+            fputc('\n', fp);
+        }
+    }
+
+    if (fclose(fp) != 0 || rename(tmp_path, store->path) != 0) {
+        perror("Failed to write profiles");
+        remove(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+void profile_store_free(ProfileStore *store) {
+    for (int i = 0; i < store->count; i++) {
+        free(store->profiles[i].outputs);
+    }
+    free(store->profiles);
+    free(store->slots);
+    memset(store, 0, sizeof(ProfileStore));
+}
+
+/**
+ * @brief O(1) lookup of the profile saved for a monitor set.
+ * @return The profile, or NULL if none was saved.
+ */
+const Profile* profile_store_find(const ProfileStore *store, uint64_t fingerprint) {
+    if (store->capacity == 0) return NULL;
+
+    int slot = (int)(fingerprint & (uint64_t)(store->capacity - 1));
+    while (store->slots[slot] != -1) {
+        const Profile *p = &store->profiles[store->slots[slot]];
+        if (p->fingerprint == fingerprint) return p;
+        slot = (slot + 1) & (store->capacity - 1);
+    }
+    return NULL;
+}
+
+const Profile* profile_store_find_by_name(const ProfileStore *store, const char *name) {
+    for (int i = 0; i < store->count; i++) {
+        if (strcmp(store->profiles[i].name, name) == 0) return &store->profiles[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Saves the current layout as the profile for the current monitor set.
+ * An existing profile for the same set is replaced.
+ * @param store The store to add to (call profile_store_save() to persist it).
+ * @param name Profile name; must not contain whitespace.
+ * @param displays The current snapshot.
+ * @param count The number of displays in the snapshot.
+ * @return The stored profile, or NULL on failure (the store is then left as it was).
+ */
+const Profile* profile_store_put(ProfileStore *store, const char *name, const Display *displays, int count) {
+    uint64_t fingerprint = monitor_set_fingerprint(displays, count);
+    if (fingerprint == 0) return NULL;
+
+    // The outputs are put together on the side, so a failure leaves the store as it was
+    Profile staged;
+    memset(&staged, 0, sizeof(staged));
+    for (int i = 0; i < count; i++) {
+        const Display *d = &displays[i];
+        if (!d->connected) continue;
+
+        ProfileOutput *o = add_profile_output(&staged);
+        if (o == NULL) {
+            free(staged.outputs);
+            return NULL;
+        }
+        snprintf(o->name, sizeof(o->name), "%s", d->name);
+        o->identity = display_identity(d);
+        o->enabled = d->is_active;
+        o->primary = d->is_primary;
+        o->width = d->width;
+        o->height = d->height;
+        snprintf(o->mode, sizeof(o->mode), "%s", d->mode_name);
+        o->rate = d->current_rate;
+        o->x_offset = d->x_offset;
+        o->y_offset = d->y_offset;
+        o->rotation = d->rotation;
+        o->scale = d->scale;
+    }
+
+    Profile *p = (Profile *)profile_store_find(store, fingerprint);
+    if (p == NULL) {
+        p = add_profile(store);
+        if (p == NULL) {
+            free(staged.outputs);
+            return NULL;
+        }
+        p->fingerprint = fingerprint;
+        if (!rebuild_index(store)) {
+            // The old index is still in place; drop the blank profile it doesn't know about
+            store->count--;
+            free(staged.outputs);
+            return NULL;
+        }
+    }
+    snprintf(p->name, sizeof(p->name), "%s", name);
+    free(p->outputs);
+    p->outputs = staged.outputs;
+    p->output_count = staged.output_count;
+    return p;
+}
+
+/**
+ * @brief Finds the display a profile output belongs to. The monitor's identity wins over
+ * the connector name, so a monitor that moved to another port (or dock) is still found.
+ * @return Index of the display, or -1 if it isn't connected.
+ */
+static int find_profile_display(const ProfileOutput *o, const Display *displays, int count) {
+    int by_identity = -1;
+    int by_name = -1;
+    for (int i = 0; i < count; i++) {
+        const Display *d = &displays[i];
+        if (!d->connected) continue;
+        bool same_name = strcmp(d->name, o->name) == 0;
+        if (o->identity != 0 && display_identity(d) == o->identity) {
+            if (same_name) return i; // Identical monitors: keep each on its own port
+            if (by_identity < 0) by_identity = i;
+        } else if (same_name) {
+            by_name = i;
+        }
+    }
+    return by_identity >= 0 ? by_identity : by_name;
+}
+
+/**
+ * @brief Turns a profile into one batched transaction, aimed at the connectors
+ * the profile's monitors are plugged into right now. Where the monitor advertises
+ * the saved mode, the closest modeline is picked so it can be applied by XID.
+ * @return True on success, false if memory ran out.
+ */
+bool profile_to_transaction(const Profile *profile, Display *displays, int count, Transaction *t) {
+    for (int i = 0; i < profile->output_count; i++) {
+        const ProfileOutput *o = &profile->outputs[i];
+        int index = find_profile_display(o, displays, count);
+        Display *d = index >= 0 ? &displays[index] : NULL;
+        OutputChange *c = transaction_output(t, d ? d->name : o->name);
+        if (c == NULL) return false;
+
+        if (!o->enabled) {
+            c->off = 1;
+            continue;
+        }
+        char mode_name[32];
+        if (o->mode[0] != '\0') {
+            snprintf(mode_name, sizeof(mode_name), "%s", o->mode);
+        } else if (rotation_is_sideways(o->rotation)) {
+            snprintf(mode_name, sizeof(mode_name), "%dx%d", o->height, o->width);
+        } else {
+            snprintf(mode_name, sizeof(mode_name), "%dx%d", o->width, o->height);
+        }
+        const Mode *mode = NULL;
+        const RefreshRate *rate = NULL;
+        if (d && display_ensure_modes(d)) {
+            rate = display_find_rate(d, mode_name, o->rate, &mode);
+        }
+        if (rate) {
+            output_change_set_mode(c, mode, rate);
+        } else {
+            snprintf(c->mode, sizeof(c->mode), "%s", mode_name);
+            c->rate = o->rate;
+        }
+        c->set_position = 1;
+        c->x_offset = o->x_offset;
+        c->y_offset = o->y_offset;
+        c->primary = o->primary;
+        if (o->rotation != 0) {
+            c->set_rotation = 1;
+            c->rotation = o->rotation;
+        }
+        if (o->scale > 0.0) c->scale = o->scale;
+    }
+    return true;
+}
+
+/**
+ * @brief Checks whether the live layout already looks like the profile, so we can skip a no-op apply.
+ */
+bool profile_matches_layout(const Profile *profile, const Display *displays, int count) {
+    for (int i = 0; i < profile->output_count; i++) {
+        const ProfileOutput *o = &profile->outputs[i];
+        int index = find_profile_display(o, displays, count);
+        if (index < 0) return false;
+        const Display *d = &displays[index];
+        if (d->is_active != o->enabled) return false;
+        if (!o->enabled) continue;
+        if (d->width != o->width || d->height != o->height ||
+            d->x_offset != o->x_offset || d->y_offset != o->y_offset ||
+            d->is_primary != o->primary || (o->rotation != 0 && d->rotation != o->rotation) ||
+            (o->scale > 0.0 && (d->scale - o->scale > 0.0005 || o->scale - d->scale > 0.0005))) {
+            return false;
+        }
+        if (o->mode[0] != '\0' && d->mode_name[0] != '\0' && strcmp(d->mode_name, o->mode) != 0) {
+            return false; // Same size, other scan type or custom mode
+        }
+        // Rates are stored with three decimals; older stores have two, like xrandr prints them.
+        double diff = d->current_rate - o->rate;
+        if (diff > 0.005 || diff < -0.005) return false;
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef PROFILES_H
+#define PROFILES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "xrandr_parser.h"
+#include "xrandr_apply.h"
+
+/**
+ * @brief The saved state of one output inside a profile.
+ */
+typedef struct {
+    char name[32];        // Connector the monitor was on when the profile was saved
+    uint64_t identity;    // See display_identity(), 0 for profiles saved before it existed
+    int enabled;
+    int primary;
+    int width;
+    int height;
+    char mode[32];        // Exact mode name, e.g. "1920x1080i"; "" means WIDTHxHEIGHT
+    double rate;
+    int x_offset;
+    int y_offset;
+    unsigned int rotation; // ROTATION_* | REFLECT_* bits; 0 for stores saved before rotation was
+    double scale;          // Likewise 0 if not saved
+} ProfileOutput;
+
+/**
+ * @brief A saved layout for one particular set of connected monitors.
+ */
+typedef struct {
+    uint64_t fingerprint; // See monitor_set_fingerprint()
+    char name[64];
+    ProfileOutput *outputs;
+    int output_count;
+} Profile;
+
+/**
+ * @brief All known profiles plus a fingerprint -> profile hash index.
+ */
+typedef struct {
+    Profile *profiles;
+    int count;
+    int *slots;    // -1 marks an empty slot
+    int capacity;  // Always a power of two (0 if empty)
+    char path[512];
+} ProfileStore;
+
+uint64_t monitor_set_fingerprint(const Display *displays, int count);
+
+bool profile_store_load(ProfileStore *store, const char *path);
+bool profile_store_save(const ProfileStore *store);
+void profile_store_free(ProfileStore *store);
+const char* profile_store_default_path(char *buf, size_t size);
+
+const Profile* profile_store_find(const ProfileStore *store, uint64_t fingerprint);
+const Profile* profile_store_find_by_name(const ProfileStore *store, const char *name);
+const Profile* profile_store_put(ProfileStore *store, const char *name, const Display *displays, int count);
+
+bool profile_to_transaction(const Profile *profile, Display *displays, int count, Transaction *t);
+bool profile_matches_layout(const Profile *profile, const Display *displays, int count);
+
+#endif // PROFILES_H
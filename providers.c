@@ -0,0 +1,135 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "providers.h"
+
+/**
+ * @brief Reads the value after a "label" somewhere in a provider line.
+ * @return The number, or 0 if the label isn't there.
+ */
+static int field_after(const char *line, const char *label) {
+    const char *p = strstr(line, label);
+    int value = 0;
+    if (p) sscanf(p + strlen(label), "%d", &value);
+    return value;
+}
+
+/**
+ * @brief Parses the output of xrandr --listproviders, e.g.
+ * "Provider 1: id: 0x1f8 cap: 0x6, Sink Output, Source Offload crtcs: 4 outputs: 3
+ *  associated providers: 0 name:NVIDIA-G0".
+ * @param fp Stream to read from.
+ * @param count Filled with the number of providers found.
+ * @return A malloc'd array (free it), or NULL if there are none or memory ran out.
+ */
+Provider* parse_providers_stream(FILE *fp, int *count) {
+    *count = 0;
+    Provider *providers = NULL;
+    char line[512];
+
+    while (fgets(line, sizeof(line), fp)) {
+        Provider p;
+        memset(&p, 0, sizeof(Provider));
+        if (sscanf(line, "Provider %d: id: %lx cap: %x", &p.index, &p.id, &p.caps) != 3) continue;
+        p.crtc_count = field_after(line, "crtcs: ");
+        p.output_count = field_after(line, "outputs: ");
+        p.associated_count = field_after(line, "associated providers: ");
+        const char *name = strstr(line, "name:");
+        if (name) {
+            snprintf(p.name, sizeof(p.name), "%.*s", (int)strcspn(name + 5, "\r\n"), name + 5);
+        }
+
+        Provider *temp = realloc(providers, (*count + 1) * sizeof(Provider));
+        if (temp == NULL) {
+            perror("Failed to reallocate memory for providers");
+            free(providers);
+            *count = 0;
+            return NULL;
+        }
+        providers = temp;
+        providers[(*count)++] = p;
+    }
+    return providers;
+}
+
+/**
+ * @brief Runs xrandr --listproviders and parses it.
+ * @param count Filled with the number of providers found.
+ * @return Same as parse_providers_stream().
+ */
+Provider* read_providers(int *count) {
+    *count = 0;
+    FILE *fp = popen("xrandr --listproviders", "r");
+    if (fp == NULL) {
+        perror("Failed to run xrandr command");
+        return NULL;
+    }
+    Provider *providers = parse_providers_stream(fp, count);
+    pclose(fp);
+    return providers;
+}
+
+/**
+ * @brief Looks a provider up the ways xrandr accepts it: by name, index or XID.
+ * @return The provider, or NULL if there is no such one.
+ */
+const Provider* provider_find(const Provider *providers, int count, const char *name) {
+    char *end;
+    unsigned long number = strtoul(name, &end, 0);
+    bool numeric = *name != '\0' && *end == '\0';
+    for (int i = 0; i < count; i++) {
+        if (strcmp(providers[i].name, name) == 0) return &providers[i];
+    }
+    for (int i = 0; numeric && i < count; i++) {
+        if ((unsigned long)providers[i].index == number || providers[i].id == number) return &providers[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief The provider that should render for a sink: the first other one that can be
+ * an output source, which is normally provider 0, the one driving the screen.
+ */
+const Provider* provider_default_source(const Provider *providers, int count, const Provider *sink) {
+    for (int i = 0; i < count; i++) {
+        if (&providers[i] != sink && (providers[i].caps & PROVIDER_SOURCE_OUTPUT)) return &providers[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Picks the usual reverse-PRIME wiring: a provider that has outputs of its own but
+ * nothing wired to it yet shows what the screen's provider (provider 0) renders.
+ * @param sink Filled with the provider whose outputs should come up.
+ * @param source Filled with the provider that renders for it.
+ * @return False if there is nothing to wire.
+ */
+bool providers_default_wiring(const Provider *providers, int count, const Provider **sink, const Provider **source) {
+    *sink = NULL;
+    *source = NULL;
+    for (int i = 1; i < count && *sink == NULL; i++) {
+        const Provider *p = &providers[i];
+        if ((p->caps & PROVIDER_SINK_OUTPUT) && p->output_count > 0 && p->associated_count == 0) *sink = p;
+    }
+    if (*sink) *source = provider_default_source(providers, count, *sink);
+    return *sink != NULL && *source != NULL;
+}
+
+/**
+ * @brief Prints the providers in the same style as fprint_displays().
+ */
+void fprint_providers(FILE *out, const Provider *providers, int count) {
+    static const char *cap_names[] = {"source output", "sink output", "source offload", "sink offload"};
+    for (int i = 0; i < count; i++) {
+        const Provider *p = &providers[i];
+        fprintf(out, "\nProvider #%d: %s (0x%lx)\n", p->index, p->name[0] ? p->name : "unnamed", p->id);
+        fprintf(out, "  Capabilities:");
+        for (int bit = 0; bit < 4; bit++) {
+            if (p->caps & (1u << bit)) fprintf(out, " %s%s", cap_names[bit], (p->caps & 0xf) >> (bit + 1) ? "," : "");
+        }
+        fprintf(out, "\n  CRTCs: %d, outputs: %d, wired to: %d provider%s\n",
+                p->crtc_count, p->output_count, p->associated_count, p->associated_count == 1 ? "" : "s");
+    }
+}
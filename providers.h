@@ -0,0 +1,33 @@
+#ifndef PROVIDERS_H
+#define PROVIDERS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// Capability bits, as in the "cap:" field of xrandr --listproviders
+#define PROVIDER_SOURCE_OUTPUT  0x1 // Can render images other providers show
+#define PROVIDER_SINK_OUTPUT    0x2 // Can show images rendered elsewhere on its outputs
+#define PROVIDER_SOURCE_OFFLOAD 0x4 // Can render for another provider (PRIME offload)
+#define PROVIDER_SINK_OFFLOAD   0x8 // Can take offloaded rendering
+
+/**
+ * @brief One GPU (or other RandR provider), from xrandr --listproviders.
+ */
+typedef struct {
+    int index;            // "Provider N", what xrandr also accepts instead of the id
+    unsigned long id;     // XID
+    unsigned int caps;    // PROVIDER_* bits
+    int crtc_count;
+    int output_count;
+    int associated_count; // Providers wired to this one as output source or offload sink
+    char name[64];        // e.g. "modesetting", "NVIDIA-G0"
+} Provider;
+
+Provider* parse_providers_stream(FILE *fp, int *count);
+Provider* read_providers(int *count);
+const Provider* provider_find(const Provider *providers, int count, const char *name);
+const Provider* provider_default_source(const Provider *providers, int count, const Provider *sink);
+bool providers_default_wiring(const Provider *providers, int count, const Provider **sink, const Provider **source);
+void fprint_providers(FILE *out, const Provider *providers, int count);
+
+#endif // PROVIDERS_H
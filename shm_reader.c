@@ -0,0 +1,166 @@
+// Needed for shm_open() and mmap() under -std=c99.
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shm_reader.h"
+
+// How often a reader retries before giving up on a writer that died mid-update.
+#define MAX_READ_ATTEMPTS 1000000
+
+/**
+ * @brief Name of the shared-memory segment: $MYRANDR_SHM or /myrandr-<uid>.
+ * @return buf.
+ */
+const char* myrandr_shm_name(char *buf, size_t size) {
+    const char *name = getenv("MYRANDR_SHM");
+    if (name && name[0] == '/') {
+        snprintf(buf, size, "%s", name);
+    } else {
+        snprintf(buf, size, "/myrandr-%ld", (long)getuid());
+    }
+    return buf;
+}
+
+/**
+ * @brief Maps the published snapshot read-only.
+ * @return False if no daemon has published one (or it has an unknown layout).
+ */
+bool myrandr_shm_attach(MyrandrShmReader *reader) {
+    reader->shm = NULL;
+
+    char name[64];
+    int fd = shm_open(myrandr_shm_name(name, sizeof(name)), O_RDONLY, 0);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SharedSnapshot)) {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, sizeof(SharedSnapshot), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the segment alive
+    if (map == MAP_FAILED) return false;
+
+    const SharedSnapshot *shm = map;
+    if (shm->magic != SNAPSHOT_MAGIC || shm->version != SNAPSHOT_VERSION) {
+        munmap(map, sizeof(SharedSnapshot));
+        return false;
+    }
+    reader->shm = shm;
+    return true;
+}
+
+void myrandr_shm_detach(MyrandrShmReader *reader) {
+    if (reader->shm) {
+        munmap((void *)reader->shm, sizeof(SharedSnapshot));
+        reader->shm = NULL;
+    }
+}
+
+/**
+ * @brief Waits for an even (stable) sequence number.
+ * @return False if the writer seems to have died mid-update.
+ */
+static bool begin_read(const SharedSnapshot *shm, uint32_t *seq) {
+    for (int i = 0; i < MAX_READ_ATTEMPTS; i++) {
+        *seq = __atomic_load_n(&shm->sequence, __ATOMIC_ACQUIRE);
+        if ((*seq & 1) == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Checks that no update started while we were copying.
+ */
+static bool end_read(const SharedSnapshot *shm, uint32_t seq) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&shm->sequence, __ATOMIC_RELAXED) == seq;
+}
+
+/**
+ * @brief Cheap change check: the sequence only moves when a new snapshot is published.
+ */
+uint32_t myrandr_shm_sequence(const MyrandrShmReader *reader) {
+    return __atomic_load_n(&reader->shm->sequence, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief True once the daemon has exited; the data is then the last thing it saw.
+ */
+bool myrandr_shm_is_stale(const MyrandrShmReader *reader) {
+    return (__atomic_load_n(&reader->shm->flags, __ATOMIC_ACQUIRE) & SNAPSHOT_FLAG_STALE) != 0;
+}
+
+/**
+ * @brief Copies just the output records (enough for "what resolution, which primary").
+ * @param reader An attached reader.
+ * @param outputs Destination array.
+ * @param max Capacity of the destination array.
+ * @param sequence If not NULL, filled with the sequence the copy belongs to.
+ * @return Number of outputs copied, or -1 if no consistent copy could be taken.
+ */
+int myrandr_shm_read_outputs(const MyrandrShmReader *reader, SnapshotOutput *outputs, int max, uint32_t *sequence) {
+    const SharedSnapshot *shm = reader->shm;
+    for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++) {
+        uint32_t seq;
+        if (!begin_read(shm, &seq)) return -1;
+
+        uint32_t count = shm->output_count;
+        if (count > SNAPSHOT_MAX_OUTPUTS) count = SNAPSHOT_MAX_OUTPUTS; // Torn read; end_read() will catch it
+        if ((int)count > max) count = max;
+        memcpy(outputs, shm->outputs, count * sizeof(SnapshotOutput));
+
+        if (end_read(shm, seq)) {
+            if (sequence) *sequence = seq;
+            return (int)count;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Copies the RandR 1.5 monitor records, what window managers place windows by.
+ * @param monitors Destination array.
+ * @param max Capacity of the destination array.
+ * @param sequence If not NULL, filled with the sequence the copy belongs to.
+ * @return Number of monitors copied, or -1 if no consistent copy could be taken.
+ */
+int myrandr_shm_read_monitors(const MyrandrShmReader *reader, SnapshotMonitor *monitors, int max, uint32_t *sequence) {
+    const SharedSnapshot *shm = reader->shm;
+    for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++) {
+        uint32_t seq;
+        if (!begin_read(shm, &seq)) return -1;
+
+        uint32_t count = shm->monitor_count;
+        if (count > SNAPSHOT_MAX_MONITORS) count = SNAPSHOT_MAX_MONITORS; // Torn read; end_read() will catch it
+        if ((int)count > max) count = max;
+        memcpy(monitors, shm->monitors, count * sizeof(SnapshotMonitor));
+
+        if (end_read(shm, seq)) {
+            if (sequence) *sequence = seq;
+            return (int)count;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Copies the whole snapshot, including mode and rate pools.
+ * @return False if no consistent copy could be taken.
+ */
+bool myrandr_shm_read_all(const MyrandrShmReader *reader, SharedSnapshot *copy) {
+    const SharedSnapshot *shm = reader->shm;
+    for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++) {
+        uint32_t seq;
+        if (!begin_read(shm, &seq)) return false;
+        memcpy(copy, shm, sizeof(SharedSnapshot));
+        if (end_read(shm, seq)) return true;
+    }
+    return false;
+}
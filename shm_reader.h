@@ -0,0 +1,31 @@
+#ifndef SHM_READER_H
+#define SHM_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "snapshot_format.h"
+
+/*
+ * Tiny reader library for the snapshot the myrandr daemon publishes.
+ * Only depends on snapshot_format.h, so status bars can copy both files.
+ *
+ * Attaching costs a couple of syscalls; after that every read is a plain
+ * memory copy guarded by the seqlock, with no syscalls and no parsing.
+ */
+
+typedef struct {
+    const SharedSnapshot *shm;
+} MyrandrShmReader;
+
+const char* myrandr_shm_name(char *buf, size_t size);
+bool myrandr_shm_attach(MyrandrShmReader *reader);
+void myrandr_shm_detach(MyrandrShmReader *reader);
+
+uint32_t myrandr_shm_sequence(const MyrandrShmReader *reader);
+bool myrandr_shm_is_stale(const MyrandrShmReader *reader);
+int myrandr_shm_read_outputs(const MyrandrShmReader *reader, SnapshotOutput *outputs, int max, uint32_t *sequence);
+int myrandr_shm_read_monitors(const MyrandrShmReader *reader, SnapshotMonitor *monitors, int max, uint32_t *sequence);
+bool myrandr_shm_read_all(const MyrandrShmReader *reader, SharedSnapshot *copy);
+
+#endif // SHM_READER_H
@@ -0,0 +1,289 @@
+// Needed for shm_open(), ftruncate() and mmap() under -std=c99.
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shm_snapshot.h"
+#include "shm_reader.h"
+#include "edid.h"
+
+static uint32_t to_millihertz(double rate) {
+    return rate > 0.0 ? (uint32_t)(rate * 1000.0 + 0.5) : 0;
+}
+
+/**
+ * @brief Flattens a Display array into the fixed layout's pools.
+ * Only the counts and pools are written; the header (magic, sequence, ...) is the caller's.
+ * Anything beyond the fixed capacities is dropped, and so are mode lists that haven't
+ * been decoded yet (call displays_ensure_modes() first if readers need them).
+ */
+void snapshot_pack(SharedSnapshot *dst, const Display *displays, int count, const ScreenInfo *screen) {
+    uint32_t outputs = 0, modes = 0, rates = 0;
+
+    dst->screen.min_width = screen->min_width;
+    dst->screen.min_height = screen->min_height;
+    dst->screen.width = screen->width;
+    dst->screen.height = screen->height;
+    dst->screen.max_width = screen->max_width;
+    dst->screen.max_height = screen->max_height;
+    dst->screen.crtcs = screen->crtcs;
+
+    for (int i = 0; i < count && outputs < SNAPSHOT_MAX_OUTPUTS; i++) {
+        const Display *d = &displays[i];
+        SnapshotOutput *o = &dst->outputs[outputs++];
+        memset(o, 0, sizeof(SnapshotOutput));
+        snprintf(o->name, sizeof(o->name), "%s", d->name);
+        o->connected = (uint8_t)d->connected;
+        o->is_active = (uint8_t)d->is_active;
+        o->is_primary = (uint8_t)d->is_primary;
+        o->width = d->width;
+        o->height = d->height;
+        o->x_offset = d->x_offset;
+        o->y_offset = d->y_offset;
+        o->rate_mhz = to_millihertz(d->current_rate);
+        o->mode_signature = d->mode_signature;
+        snprintf(o->mode_name, sizeof(o->mode_name), "%s", d->mode_name);
+        o->crtc = d->crtc;
+        o->possible_crtcs = d->possible_crtcs;
+        o->rotation = d->rotation;
+        o->rotations = d->rotations;
+        o->scale_milli = (uint32_t)(d->scale * 1000.0 + 0.5);
+        o->width_mm = d->width_mm;
+        o->height_mm = d->height_mm;
+        o->panning[0] = d->panning_width;
+        o->panning[1] = d->panning_height;
+        o->panning[2] = d->panning_x;
+        o->panning[3] = d->panning_y;
+        o->tile_group = d->tile_group;
+        o->tile_columns = d->tile_columns;
+        o->tile_rows = d->tile_rows;
+        o->tile_column = d->tile_column;
+        o->tile_row = d->tile_row;
+        o->tile_width = d->tile_width;
+        o->tile_height = d->tile_height;
+        if (d->connected) {
+            const EdidInfo *edid = display_edid(d);
+            o->identity = display_identity(d);
+            snprintf(o->model, sizeof(o->model), "%s", edid ? edid->model : "");
+        }
+        o->first_mode = modes;
+
+        for (int j = 0; j < d->mode_count && modes < SNAPSHOT_MAX_MODES; j++) {
+            const Mode *m = &d->modes[j];
+            SnapshotMode *sm = &dst->modes[modes++];
+            snprintf(sm->name, sizeof(sm->name), "%s", m->name);
+            sm->width = m->width;
+            sm->height = m->height;
+            sm->interlaced = (uint8_t)m->interlaced;
+            sm->doublescan = (uint8_t)m->doublescan;
+            sm->reserved = 0;
+            sm->first_rate = rates;
+            sm->rate_count = 0;
+
+            for (int k = 0; k < m->rate_count && rates < SNAPSHOT_MAX_RATES; k++) {
+                const RefreshRate *r = &m->refresh_rates[k];
+                SnapshotRate *sr = &dst->rates[rates++];
+                sr->rate_mhz = to_millihertz(r->rate);
+                sr->is_current = (uint8_t)r->is_current;
+                sr->is_preferred = (uint8_t)r->is_preferred;
+                sr->reserved = 0;
+                sm->rate_count++;
+            }
+            o->mode_count++;
+        }
+    }
+
+    dst->output_count = outputs;
+    dst->mode_count = modes;
+    dst->rate_count = rates;
+}
+
+/**
+ * @brief Copies the RandR 1.5 monitors into the fixed layout. snapshot_pack() leaves them
+ * out, since they come from a query of their own; anything beyond the capacity is dropped.
+ */
+void snapshot_pack_monitors(SharedSnapshot *dst, const LogicalMonitor *monitors, int count) {
+    uint32_t n = 0;
+    for (int i = 0; i < count && n < SNAPSHOT_MAX_MONITORS; i++) {
+        const LogicalMonitor *m = &monitors[i];
+        SnapshotMonitor *sm = &dst->monitors[n++];
+        memset(sm, 0, sizeof(SnapshotMonitor));
+        snprintf(sm->name, sizeof(sm->name), "%s", m->name);
+        sm->automatic = m->automatic;
+        sm->is_primary = m->primary;
+        sm->width = m->width;
+        sm->height = m->height;
+        sm->width_mm = m->width_mm;
+        sm->height_mm = m->height_mm;
+        sm->x_offset = m->x_offset;
+        sm->y_offset = m->y_offset;
+        snprintf(sm->outputs, sizeof(sm->outputs), "%s", m->outputs);
+    }
+    dst->monitor_count = n;
+}
+
+/**
+ * @brief Rebuilds a Display array from the fixed layout (the inverse of snapshot_pack()).
+ * @param src A packed snapshot.
+ * @param display_count Filled with the number of displays.
+ * @param screen Filled with the screen's framebuffer limits.
+ * @return Same as parse_xrandr_output(), or NULL on failure or an empty snapshot.
+ */
+Display* snapshot_unpack(const SharedSnapshot *src, int *display_count, ScreenInfo *screen) {
+    *display_count = 0;
+    screen->min_width = src->screen.min_width;
+    screen->min_height = src->screen.min_height;
+    screen->width = src->screen.width;
+    screen->height = src->screen.height;
+    screen->max_width = src->screen.max_width;
+    screen->max_height = src->screen.max_height;
+    screen->crtcs = src->screen.crtcs;
+    uint32_t outputs = src->output_count;
+    if (outputs == 0 || outputs > SNAPSHOT_MAX_OUTPUTS) return NULL;
+
+    Display *displays = calloc(outputs, sizeof(Display));
+    if (displays == NULL) return NULL;
+
+    for (uint32_t i = 0; i < outputs; i++) {
+        const SnapshotOutput *o = &src->outputs[i];
+        Display *d = &displays[i];
+        *display_count = i + 1; // So free_displays() can clean up a partial result
+
+        snprintf(d->name, sizeof(d->name), "%.*s", (int)sizeof(o->name), o->name);
+        d->connected = o->connected;
+        d->is_active = o->is_active;
+        d->is_primary = o->is_primary;
+        d->width = o->width;
+        d->height = o->height;
+        d->x_offset = o->x_offset;
+        d->y_offset = o->y_offset;
+        d->current_rate = o->rate_mhz / 1000.0;
+        d->mode_signature = o->mode_signature;
+        snprintf(d->mode_name, sizeof(d->mode_name), "%.*s", (int)sizeof(o->mode_name), o->mode_name);
+        d->crtc = o->crtc;
+        d->possible_crtcs = o->possible_crtcs;
+        d->rotation = o->rotation;
+        d->rotations = o->rotations;
+        d->scale = o->scale_milli > 0 ? o->scale_milli / 1000.0 : 1.0;
+        d->width_mm = o->width_mm;
+        d->height_mm = o->height_mm;
+        d->panning_width = o->panning[0];
+        d->panning_height = o->panning[1];
+        d->panning_x = o->panning[2];
+        d->panning_y = o->panning[3];
+        d->tile_group = o->tile_group;
+        d->tile_columns = o->tile_columns;
+        d->tile_rows = o->tile_rows;
+        d->tile_column = o->tile_column;
+        d->tile_row = o->tile_row;
+        d->tile_width = o->tile_width;
+        d->tile_height = o->tile_height;
+
+        if (o->mode_count == 0) continue;
+        if (o->first_mode + o->mode_count > SNAPSHOT_MAX_MODES) goto corrupt;
+        d->modes = calloc(o->mode_count, sizeof(Mode));
+        if (d->modes == NULL) goto corrupt;
+        d->mode_count = o->mode_count;
+
+        for (uint32_t j = 0; j < o->mode_count; j++) {
+            const SnapshotMode *sm = &src->modes[o->first_mode + j];
+            Mode *m = &d->modes[j];
+            snprintf(m->name, sizeof(m->name), "%.*s", (int)sizeof(sm->name), sm->name);
+            m->width = sm->width;
+            m->height = sm->height;
+            m->interlaced = sm->interlaced;
+            m->doublescan = sm->doublescan;
+
+            if (sm->rate_count == 0) continue;
+            if (sm->first_rate + sm->rate_count > SNAPSHOT_MAX_RATES) goto corrupt;
+            m->refresh_rates = calloc(sm->rate_count, sizeof(RefreshRate));
+            if (m->refresh_rates == NULL) goto corrupt;
+            m->rate_count = sm->rate_count;
+
+            for (uint32_t k = 0; k < sm->rate_count; k++) {
+                const SnapshotRate *sr = &src->rates[sm->first_rate + k];
+                m->refresh_rates[k].rate = sr->rate_mhz / 1000.0;
+                m->refresh_rates[k].is_current = sr->is_current;
+                m->refresh_rates[k].is_preferred = sr->is_preferred;
+            }
+        }
+    }
+    return displays;
+
+corrupt:
+    free_displays(displays, *display_count);
+    *display_count = 0;
+    return NULL;
+}
+
+/**
+ * @brief Creates (or takes over) the shared-memory segment.
+ * @return True on success, false on failure.
+ */
+bool shm_publisher_open(ShmPublisher *pub) {
+    pub->shm = NULL;
+    myrandr_shm_name(pub->name, sizeof(pub->name));
+
+    // Readable by anyone: it's the same information xrandr prints.
+    int fd = shm_open(pub->name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        perror("Failed to open shared-memory snapshot");
+        return false;
+    }
+    if (ftruncate(fd, sizeof(SharedSnapshot)) != 0) {
+        perror("Failed to size shared-memory snapshot");
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, sizeof(SharedSnapshot), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("Failed to map shared-memory snapshot");
+        return false;
+    }
+
+    pub->shm = map;
+    // Keep counting from whatever a previous daemon left, so readers still see a change,
+    // but never start in the middle of an update.
+    uint32_t seq = pub->shm->magic == SNAPSHOT_MAGIC ? (pub->shm->sequence + 1) & ~1U : 0;
+    __atomic_store_n(&pub->shm->sequence, seq, __ATOMIC_RELAXED);
+    pub->shm->version = SNAPSHOT_VERSION;
+    pub->shm->writer_pid = (int32_t)getpid();
+    pub->shm->flags = 0;
+    __atomic_store_n(&pub->shm->magic, SNAPSHOT_MAGIC, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * @brief Publishes a new snapshot. Readers never block; they retry if they overlap an update.
+ */
+void shm_publisher_publish(ShmPublisher *pub, const Display *displays, int count, const ScreenInfo *screen,
+                           const LogicalMonitor *monitors, int monitor_count) {
+    if (pub->shm == NULL) return;
+
+    uint32_t seq = pub->shm->sequence;
+    __atomic_store_n(&pub->shm->sequence, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    snapshot_pack(pub->shm, displays, count, screen);
+    snapshot_pack_monitors(pub->shm, monitors, monitor_count);
+
+    __atomic_store_n(&pub->shm->sequence, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Marks the snapshot stale for readers that still have it mapped and removes the name.
+ */
+void shm_publisher_close(ShmPublisher *pub) {
+    if (pub->shm == NULL) return;
+
+    __atomic_or_fetch(&pub->shm->flags, SNAPSHOT_FLAG_STALE, __ATOMIC_RELEASE);
+    munmap(pub->shm, sizeof(SharedSnapshot));
+    shm_unlink(pub->name);
+    pub->shm = NULL;
+}
@@ -0,0 +1,26 @@
+#ifndef SHM_SNAPSHOT_H
+#define SHM_SNAPSHOT_H
+
+#include <stdbool.h>
+#include "xrandr_parser.h"
+#include "logical_monitors.h"
+#include "snapshot_format.h"
+
+/**
+ * @brief Writer side of the shared-memory snapshot (see shm_reader.h for readers).
+ */
+typedef struct {
+    SharedSnapshot *shm;
+    char name[64];
+} ShmPublisher;
+
+bool shm_publisher_open(ShmPublisher *pub);
+void shm_publisher_publish(ShmPublisher *pub, const Display *displays, int count, const ScreenInfo *screen,
+                           const LogicalMonitor *monitors, int monitor_count);
+void shm_publisher_close(ShmPublisher *pub);
+
+void snapshot_pack(SharedSnapshot *dst, const Display *displays, int count, const ScreenInfo *screen);
+void snapshot_pack_monitors(SharedSnapshot *dst, const LogicalMonitor *monitors, int count);
+Display* snapshot_unpack(const SharedSnapshot *src, int *display_count, ScreenInfo *screen);
+
+#endif // SHM_SNAPSHOT_H
@@ -0,0 +1,90 @@
+// Needed for mmap() and friends under -std=c99.
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snapshot_cache.h"
+#include "snapshot_format.h"
+#include "shm_snapshot.h"
+#include "fs_util.h"
+
+/*
+ * The cache file is just a SharedSnapshot (see snapshot_format.h) written
+ * to disk, so loading it is one mmap() plus unpacking the pools. The
+ * magic/version fields in the header reject files from other layouts.
+ */
+
+/**
+ * @brief Where the last-known snapshot is kept: $XDG_CACHE_HOME/myrandr/snapshot.bin or ~/.cache/myrandr/snapshot.bin.
+ * @return buf, or NULL if neither variable is set.
+ */
+const char* snapshot_cache_path(char *buf, size_t size) {
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && xdg[0] != '\0') {
+        snprintf(buf, size, "%s/myrandr/snapshot.bin", xdg);
+    } else if (home && home[0] != '\0') {
+        snprintf(buf, size, "%s/.cache/myrandr/snapshot.bin", home);
+    } else {
+        return NULL;
+    }
+    return buf;
+}
+
+/**
+ * @brief Persists a snapshot for the next cold start.
+ * @return True on success, false on failure.
+ */
+bool snapshot_cache_save(const Display *displays, int count, const ScreenInfo *screen) {
+    char path[512];
+    if (!snapshot_cache_path(path, sizeof(path))) return false;
+
+    SharedSnapshot *snap = calloc(1, sizeof(SharedSnapshot));
+    if (snap == NULL) return false;
+    snap->magic = SNAPSHOT_MAGIC;
+    snap->version = SNAPSHOT_VERSION;
+    snapshot_pack(snap, displays, count, screen);
+
+    bool ok = write_file_atomic(path, snap, sizeof(SharedSnapshot));
+    free(snap);
+    return ok;
+}
+
+/**
+ * @brief Loads the last-known snapshot, if there is a valid one.
+ * @param display_count Filled with the number of displays.
+ * @param screen Filled with the screen's framebuffer limits.
+ * @return Same as parse_xrandr_output(), or NULL if there is no usable cache.
+ */
+Display* snapshot_cache_load(int *display_count, ScreenInfo *screen) {
+    *display_count = 0;
+    memset(screen, 0, sizeof(ScreenInfo));
+
+    char path[512];
+    if (!snapshot_cache_path(path, sizeof(path))) return NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != sizeof(SharedSnapshot)) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, sizeof(SharedSnapshot), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    const SharedSnapshot *snap = map;
+    Display *displays = NULL;
+    if (snap->magic == SNAPSHOT_MAGIC && snap->version == SNAPSHOT_VERSION) {
+        displays = snapshot_unpack(snap, display_count, screen);
+    }
+    munmap(map, sizeof(SharedSnapshot));
+    return displays;
+}
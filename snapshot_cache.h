@@ -0,0 +1,12 @@
+#ifndef SNAPSHOT_CACHE_H
+#define SNAPSHOT_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "xrandr_parser.h"
+
+const char* snapshot_cache_path(char *buf, size_t size);
+bool snapshot_cache_save(const Display *displays, int count, const ScreenInfo *screen);
+Display* snapshot_cache_load(int *display_count, ScreenInfo *screen);
+
+#endif // SNAPSHOT_CACHE_H
@@ -0,0 +1,112 @@
+#ifndef SNAPSHOT_FORMAT_H
+#define SNAPSHOT_FORMAT_H
+
+#include <stdint.h>
+
+/*
+ * Fixed binary layout of a parsed snapshot. Used for the shared-memory
+ * segment the daemon publishes, so readers never parse anything.
+ *
+ * Everything lives in fixed-capacity pools: an output points at a run of
+ * modes, a mode at a run of rates. Snapshots that don't fit are truncated.
+ */
+
+#define SNAPSHOT_MAGIC 0x5252594dU // "MYRR" in memory on little-endian
+#define SNAPSHOT_VERSION 11
+
+#define SNAPSHOT_MAX_OUTPUTS 32
+#define SNAPSHOT_MAX_MODES 1024
+#define SNAPSHOT_MAX_RATES 4096
+#define SNAPSHOT_MAX_MONITORS 16
+
+// Set in SharedSnapshot.flags once the writer has gone away.
+#define SNAPSHOT_FLAG_STALE 0x1
+
+typedef struct {
+    uint32_t rate_mhz; // Refresh rate in millihertz
+    uint8_t is_current;
+    uint8_t is_preferred;
+    uint16_t reserved;
+} SnapshotRate;
+
+typedef struct {
+    char name[32];       // e.g. "1920x1080i" or "my-mode"
+    int32_t width;
+    int32_t height;
+    uint8_t interlaced;
+    uint8_t doublescan;
+    uint16_t reserved;
+    uint32_t first_rate; // Index into SharedSnapshot.rates
+    uint32_t rate_count;
+} SnapshotMode;
+
+typedef struct {
+    char name[32];
+    uint8_t connected;
+    uint8_t is_active;
+    uint8_t is_primary;
+    uint8_t reserved;
+    int32_t width;
+    int32_t height;
+    int32_t x_offset;
+    int32_t y_offset;
+    uint32_t rate_mhz;   // Current refresh rate, 0 if off
+    uint32_t first_mode; // Index into SharedSnapshot.modes
+    uint32_t mode_count; // 0 if the writer never decoded this output's modes
+    uint64_t mode_signature; // Changes whenever the mode list does
+    uint64_t identity;       // Stable monitor identity from the EDID (see edid.h)
+    char model[16];          // Monitor name from the EDID, "" if unknown
+    char mode_name[32];      // Name of the current mode, "" if off
+    int32_t crtc;            // CRTC driving the output, -1 if none
+    uint32_t possible_crtcs; // Bit i set if CRTC i can drive it
+    uint32_t rotation;       // ROTATION_* | REFLECT_* bits (see xrandr_parser.h)
+    uint32_t rotations;      // The ones the output supports
+    uint32_t scale_milli;    // Scale factor in thousandths, 1000 if unscaled
+    int32_t width_mm;        // Physical size from the header line, 0 if unknown
+    int32_t height_mm;
+    int32_t panning[4];      // Width, height, x, y of the panning area, all 0 if none
+    int32_t tile_group;      // TILE property (see Display), 0 if not a tile
+    int32_t tile_columns, tile_rows;
+    int32_t tile_column, tile_row;
+    int32_t tile_width, tile_height;
+} SnapshotOutput;
+
+typedef struct {
+    char name[64];        // RandR 1.5 monitor, from xrandr --listmonitors
+    uint8_t automatic;    // Made by the server for an output
+    uint8_t is_primary;
+    uint16_t reserved;
+    int32_t width;
+    int32_t height;
+    int32_t width_mm;
+    int32_t height_mm;
+    int32_t x_offset;
+    int32_t y_offset;
+    char outputs[128];    // Comma separated output names, "" if none
+} SnapshotMonitor;
+
+typedef struct {
+    int32_t min_width, min_height;
+    int32_t width, height;
+    int32_t max_width, max_height; // All zero if unknown
+    uint32_t crtcs;                // Bit i set for CRTC i
+} SnapshotScreen;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sequence; // Seqlock: odd while the writer is in the middle of an update
+    uint32_t flags;
+    int32_t writer_pid;
+    uint32_t output_count;
+    uint32_t mode_count;
+    uint32_t rate_count;
+    uint32_t monitor_count;
+    SnapshotScreen screen;
+    SnapshotOutput outputs[SNAPSHOT_MAX_OUTPUTS];
+    SnapshotMode modes[SNAPSHOT_MAX_MODES];
+    SnapshotRate rates[SNAPSHOT_MAX_RATES];
+    SnapshotMonitor monitors[SNAPSHOT_MAX_MONITORS];
+} SharedSnapshot;
+
+#endif // SNAPSHOT_FORMAT_H
@@ -1,20 +1,42 @@
+// Needed for clock_gettime() under -std=c99.
+#define _POSIX_C_SOURCE 200809L
+
 #include <ncurses.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h> // For bool type
+#include <time.h>
 #include "xrandr_parser.h"
+#include "display_diff.h"
+#include "xrandr_apply.h"
+#include "profiles.h"
+#include "cli.h"
+#include "daemon.h"
+#include "xrandr_query.h"
+#include "snapshot_cache.h"
+#include "edid.h"
+#include "providers.h"
+#include "layout.h"
+#include "logical_monitors.h"
 
 // Minimum terminal dimensions required for the TUI
 #define MIN_ROWS 20
 #define MIN_COLS 80
 
+// Size of the status line that summarises what the last refresh changed
+#define STATUS_LEN 128
+// How often to check on the background xrandr query while showing cached data
+#define LIVE_POLL_MS 20
 
 // Determining which panel is active.
 typedef enum {
     STATE_MONITOR_SELECT,
     STATE_MODE_SELECT,
     STATE_RATE_SELECT,
-    STATE_POSITION_SELECT
+    STATE_POSITION_SELECT,
+    STATE_LAYOUT_MAP,
+    STATE_VIDEO_WALL,
+    STATE_LOGICAL_MONITORS
 } AppState;
 
 /**
@@ -47,11 +69,14 @@ void cleanup_ncurses() {
  * @brief Draws the main UI border and title.
  * @param rows Total rows of the terminal.
  * @param cols Total columns of the terminal.
+ * @param status What changed on the last refresh (may be empty).
  */
-void draw_border(int rows, int cols, AppState state) {
-    (void)cols; // I kept it for potential future use.
+void draw_border(int rows, int cols, AppState state, const char *status) {
     box(stdscr, 0, 0);
     mvprintw(0, 2, " myrandr - Display Manager ");
+    if (status && status[0] != '\0') {
+        mvprintw(0, 31, " %.*s ", cols - 35 > 0 ? cols - 35 : 0, status);
+    }
 
     const char* help_text;
     switch(state) {
@@ -59,19 +84,69 @@ void draw_border(int rows, int cols, AppState state) {
             help_text = "j/k: Select Mode | h/Left: Back | l/Right/Enter: Select Rate | q: Quit";
             break;
         case STATE_POSITION_SELECT:
-            help_text = "j/k: Select | Tab: Switch | h/Left: Back | Enter: Apply | q: Quit";
+            help_text = "j/k: Select | Tab: Switch | h/Left: Back | Enter: Place | q: Quit";
             break;
         case STATE_RATE_SELECT:
             help_text = "j/k: Select Rate | h/Left: Back | Enter: Apply | q: Quit";
             break;
+        case STATE_LAYOUT_MAP:
+            help_text = "h/j/k/l: Move | Tab: Next | +/-: Step | s: Snap | Enter: Apply | v: Back | q: Quit";
+            break;
+        case STATE_VIDEO_WALL:
+            help_text = "j/k: Select | Space: Add/Remove | [/]: Columns | b/B: Bezel | o: Order | Enter: Apply | g: Back | q: Quit";
+            break;
+        case STATE_LOGICAL_MONITORS:
+            help_text = "j/k: Select | s: Split | </>: Narrow/Widen | d: Delete | Enter: Apply | x: Back | q: Quit";
+            break;
         case STATE_MONITOR_SELECT:
         default:
-            help_text = "j/k: Select Display | o: On/Off | p: Position | m: Make Primary | l/Right/Enter: Modes | q: Quit";
+            // The rest are behind '?', see draw_keys_overlay(); all of them don't fit 80 columns
+            help_text = "j/k: Select | o: On/Off | a: Apply | l/Enter: Modes | ?: Keys | q: Quit";
             break;
     }
     mvprintw(rows - 1, 2, " %s ", help_text);
 }
 
+/**
+ * @brief Every key of the main screen, as '?' lists them.
+ */
+static const char *main_keys[] = {
+    "j/k       Select an output",
+    "o         Turn it on or off",
+    "p         Place it next to another",
+    "a         Apply the placements and changes",
+    "v         Move outputs on the layout map",
+    "g         Set up a video wall",
+    "x         Edit RandR 1.5 monitors",
+    "t/f       Rotate / flip",
+    "+/-       Scale up / down",
+    "n         Even out DPI across outputs",
+    "m         Make it the primary output",
+    "s         Save the setup as a profile",
+    "r         Refresh",
+    "w         Wire up another GPU",
+    "l/Enter   Pick a mode and rate",
+    "q         Quit",
+};
+
+/**
+ * @brief Draws the main screen's keys in a box over everything else, until the next key press.
+ */
+void draw_keys_overlay(int rows, int cols) {
+    int count = sizeof(main_keys) / sizeof(main_keys[0]);
+    int height = count + 2, width = 48;
+    if (height > rows - 2) height = rows - 2;
+    WINDOW *win = newwin(height, width, (rows - height) / 2, (cols - width) / 2);
+    if (win == NULL) return;
+    box(win, 0, 0);
+    mvwprintw(win, 0, 2, " Keys (any key to close) ");
+    for (int i = 0; i < count && i < height - 2; i++) {
+        mvwprintw(win, i + 1, 2, "%s", main_keys[i]);
+    }
+    wrefresh(win);
+    delwin(win);
+}
+
 /**
  * @brief Draws the list of monitors on the left.
  * @param items An array of strings for the menu items.
@@ -143,10 +218,148 @@ void draw_position_panel(
     if (!dir_active) wattroff(stdscr, A_DIM);
 }
 
+/**
+ * @brief Draws one output of the layout map as a box with its name inside.
+ */
+static void draw_map_box(const PlannedOutput *p, const char *name, bool selected,
+                         int min_x, int min_y, int scale, int top, int left) {
+    if (!p->lit || p->width <= 0) return;
+    int x0 = left + (p->x_offset - min_x) / scale;
+    int y0 = top + (p->y_offset - min_y) / (2 * scale);
+    int x1 = left + (p->x_offset + p->width - min_x) / scale - 1;
+    int y1 = top + (p->y_offset + p->height - min_y) / (2 * scale) - 1;
+    if (x1 <= x0) x1 = x0 + 1;
+    if (y1 <= y0) y1 = y0 + 1;
+
+    if (selected) wattron(stdscr, A_BOLD);
+    mvhline(y0, x0 + 1, ACS_HLINE, x1 - x0 - 1);
+    mvhline(y1, x0 + 1, ACS_HLINE, x1 - x0 - 1);
+    mvvline(y0 + 1, x0, ACS_VLINE, y1 - y0 - 1);
+    mvvline(y0 + 1, x1, ACS_VLINE, y1 - y0 - 1);
+    mvaddch(y0, x0, ACS_ULCORNER);
+    mvaddch(y0, x1, ACS_URCORNER);
+    mvaddch(y1, x0, ACS_LLCORNER);
+    mvaddch(y1, x1, ACS_LRCORNER);
+    // Clear the inside, so an overlapped box doesn't show through
+    for (int y = y0 + 1; y < y1; y++) mvhline(y, x0 + 1, ' ', x1 - x0 - 1);
+    if (selected) wattron(stdscr, A_REVERSE);
+    if (y1 - y0 > 1 && x1 - x0 > 1) mvprintw((y0 + y1) / 2, x0 + 1, "%.*s", x1 - x0 - 1, name);
+    wattroff(stdscr, A_BOLD | A_REVERSE);
+}
+
+/**
+ * @brief Draws every lit output as a box, scaled down to fit the area given.
+ * A character cell is about twice as tall as wide, so rows cover twice the pixels.
+ */
+void draw_layout_map(const LayoutMap *map, const Display *displays, int top, int left, int height, int width) {
+    int min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+    bool any = false;
+    for (int i = 0; i < map->count; i++) {
+        const PlannedOutput *p = &map->planned[i];
+        if (!p->lit || p->width <= 0) continue;
+        if (!any || p->x_offset < min_x) min_x = p->x_offset;
+        if (!any || p->y_offset < min_y) min_y = p->y_offset;
+        if (!any || p->x_offset + p->width > max_x) max_x = p->x_offset + p->width;
+        if (!any || p->y_offset + p->height > max_y) max_y = p->y_offset + p->height;
+        any = true;
+    }
+    if (!any || height < 3 || width < 3) return;
+
+    // Pixels per column; rows get twice that
+    int scale_x = (max_x - min_x + width - 2) / (width - 1);
+    int scale_y = (max_y - min_y + 2 * (height - 1) - 1) / (2 * (height - 1));
+    int scale = scale_x > scale_y ? scale_x : scale_y;
+    if (scale < 1) scale = 1;
+
+    // The selected output goes last, so it's drawn on top where boxes overlap
+    for (int i = 0; i < map->count; i++) {
+        if (i != map->selected) draw_map_box(&map->planned[i], displays[i].name, false, min_x, min_y, scale, top, left);
+    }
+    draw_map_box(&map->planned[map->selected], displays[map->selected].name, true, min_x, min_y, scale, top, left);
+}
+
+/**
+ * @brief Shows the video wall being put together: the outputs in the order they were
+ * picked, where each one lands and the mode they'll all run.
+ * @param outputs Indexes into displays, in wall order.
+ */
+void draw_wall_panel(const GridSpec *grid, const Display *displays, const int *outputs, int n, int rows, int cols) {
+    int start_col = cols / 3;
+    int y = 2;
+    mvvline(1, start_col - 2, ACS_VLINE, rows - 2);
+    mvprintw(y++, start_col, "Video wall: %dx%d, bezel %d/%dpx, %s first", grid->rows, grid->columns,
+             grid->bezel_x, grid->bezel_y, grid->order == GRID_ROWS_FIRST ? "rows" : "columns");
+    y++;
+    if (n == 0) {
+        mvprintw(y, start_col, "Press Space on the outputs to put on the wall, in order.");
+        return;
+    }
+
+    Transaction t;
+    transaction_init(&t);
+    CommonMode mode;
+    char reason[STATUS_LEN];
+    bool planned = layout_grid(grid, displays, outputs, n, &t, &mode, reason, sizeof(reason));
+    int wall_width = 0, wall_height = 0;
+    bool sideways = n > 0 && rotation_is_sideways(displays[outputs[0]].rotation);
+    for (int i = 0; i < n && y < rows - 4; i++) {
+        const OutputChange *c = planned ? &t.outputs[i] : NULL;
+        if (c) {
+            mvprintw(y++, start_col + 2, "%2d. %s at +%d+%d", i + 1, displays[outputs[i]].name, c->x_offset, c->y_offset);
+            int width = sideways ? mode.height : mode.width;
+            int height = sideways ? mode.width : mode.height;
+            if (c->x_offset + width > wall_width) wall_width = c->x_offset + width;
+            if (c->y_offset + height > wall_height) wall_height = c->y_offset + height;
+        } else {
+            mvprintw(y++, start_col + 2, "%2d. %s", i + 1, displays[outputs[i]].name);
+        }
+    }
+    y++;
+    if (!planned) {
+        mvprintw(y, start_col, "%.*s.", cols - start_col - 3, reason);
+    } else {
+        if (mode.rate > 0.0) {
+            mvprintw(y++, start_col, "Mode: %dx%d @ %.2fHz on all of them", mode.width, mode.height, mode.rate);
+        } else {
+            mvprintw(y++, start_col, "Mode: %dx%d on all of them", mode.width, mode.height);
+        }
+        mvprintw(y, start_col, "Wall: %dx%d pixels", wall_width, wall_height);
+    }
+    transaction_free(&t);
+}
+
+/**
+ * @brief Draws the RandR 1.5 monitors being edited ('x'), with the selected one highlighted.
+ * @param changed How many edits wait for Enter.
+ */
+void draw_logical_monitors_panel(const LogicalMonitor *monitors, int count, int highlight, int changed,
+                                 int rows, int cols) {
+    int start_col = cols / 3;
+    int y = 2;
+    mvvline(1, start_col - 2, ACS_VLINE, rows - 2);
+    mvprintw(y++, start_col, "Monitors (what window managers place windows on):");
+    y++;
+    for (int i = 0; i < count && y < rows - 4; i++) {
+        const LogicalMonitor *m = &monitors[i];
+        if (i == highlight) wattron(stdscr, A_REVERSE);
+        mvprintw(y++, start_col + 2, "%-16.16s %dx%d+%d+%d  %s%s", m->name, m->width, m->height, m->x_offset,
+                 m->y_offset, m->outputs[0] ? m->outputs : "none", m->automatic ? " (server's)" : "");
+        if (i == highlight) wattroff(stdscr, A_REVERSE);
+    }
+    if (count == 0) mvprintw(y++, start_col + 2, "None reported (needs RandR 1.5).");
+    y++;
+    if (changed > 0) mvprintw(y, start_col, "%d change%s, press Enter to apply", changed, changed == 1 ? "" : "s");
+}
+
 /**
  * @brief Draws the right-hand panel, which shows display info, modes, and rates.
+ * @param crtc_note Why the display can't be turned on right now, "" if it can.
+ * @param placement Where the display is placed in the layout that's waiting to be applied, or NULL.
+ * @param pending The display's changes waiting to be applied with the layout, or NULL.
+ * @param screen_note What the pending changes do to the screen size, "" if nothing is pending.
  */
-void draw_right_panel(const Display *display, AppState state, int mode_highlight, int rate_highlight, int mode_scroll, int rate_scroll,
+void draw_right_panel(const Display *display, const char *crtc_note, const LayoutConstraint *placement,
+                      const OutputChange *pending, const char *screen_note, AppState state, int mode_highlight, int rate_highlight, int mode_scroll, int rate_scroll,
                       Display** pos_targets, int pos_target_count, int pos_target_highlight,
                       const char** pos_directions, int pos_direction_count, int pos_direction_highlight, PositionPanelFocus pos_focus,
                       int rows, int cols) {
@@ -158,28 +371,66 @@ void draw_right_panel(const Display *display, AppState state, int mode_highlight
 
     // Basic Info
     mvprintw(y++, start_col, "Display: %s (%s)", display->name, display->is_primary ? "Primary" : "Secondary");
+    const EdidInfo *edid = display_edid(display);
+    if (edid) {
+        mvprintw(y++, start_col, "Monitor: %s (%s, %dx%d mm)", edid->model[0] ? edid->model : "unnamed",
+                 edid->manufacturer, edid->width_mm, edid->height_mm);
+    }
     if (display->width > 0) {
-        // Find the current refresh rate by looking for the '*' marker
-        double current_rate = 0.0;
-        bool rate_found = false;
-        for (int i = 0; i < display->mode_count; i++) {
-            for (int j = 0; j < display->modes[i].rate_count; j++) {
-                if (display->modes[i].refresh_rates[j].is_current) {
-                    current_rate = display->modes[i].refresh_rates[j].rate;
-                    rate_found = true;
-                    break;
-                }
-            }
-            if (rate_found) {
-                break;
-            }
-        }
-
-        if (rate_found) {
-            mvprintw(y++, start_col, "Current: %dx%d+%d+%d @ %.2fHz", display->width, display->height, display->x_offset, display->y_offset, current_rate);
+        // The parser keeps the '*' rate aside, so this works before the modes are decoded
+        if (display->current_rate > 0.0) {
+            mvprintw(y++, start_col, "Current: %dx%d+%d+%d @ %.2fHz", display->width, display->height, display->x_offset, display->y_offset, display->current_rate);
         } else {
             mvprintw(y++, start_col, "Current: %dx%d+%d+%d", display->width, display->height, display->x_offset, display->y_offset);
         }
+        mvprintw(y++, start_col, "Rotation: %s, reflect %s", rotation_name(display->rotation), reflection_name(display->rotation));
+        if (display->scale != 1.0) mvprintw(y++, start_col, "Scale: %.2f", display->scale);
+        if (display->panning_width > 0) {
+            mvprintw(y++, start_col, "Panning: %dx%d+%d+%d", display->panning_width, display->panning_height,
+                     display->panning_x, display->panning_y);
+        }
+    }
+    if (display->tile_group != 0) {
+        mvprintw(y++, start_col, "Tiled: %dx%d tiles of %dx%d, handled as one monitor", display->tile_columns,
+                 display->tile_rows, display->tile_width, display->tile_height);
+    }
+    if (display->width_mm > 0) {
+        double dpi = display_dpi(display);
+        if (dpi > 0.0) mvprintw(y++, start_col, "Physical: %dx%d mm, %.0f DPI", display->width_mm, display->height_mm, dpi);
+        else mvprintw(y++, start_col, "Physical: %dx%d mm", display->width_mm, display->height_mm);
+    }
+    if (display->possible_crtcs != 0) {
+        char crtcs[96] = "";
+        size_t len = 0;
+        for (int c = 0; c < 32 && len < sizeof(crtcs); c++) {
+            if (display->possible_crtcs & ((uint32_t)1 << c)) len += snprintf(crtcs + len, sizeof(crtcs) - len, " %d", c);
+        }
+        if (display->crtc >= 0) mvprintw(y++, start_col, "CRTC: %d (can use%s)", display->crtc, crtcs);
+        else mvprintw(y++, start_col, "CRTC: none (can use%s)", crtcs);
+    }
+    if (crtc_note[0] != '\0') {
+        // The reason names several outputs, so it gets wrapped to the panel
+        int width = cols - start_col - 4;
+        size_t len = strlen(crtc_note);
+        wattron(stdscr, A_BOLD);
+        mvprintw(y++, start_col, "Can't turn on:");
+        for (size_t off = 0; off < len && width > 0; off += width) {
+            mvprintw(y++, start_col + 2, "%.*s", width, crtc_note + off);
+        }
+        wattroff(stdscr, A_BOLD);
+    }
+    if (placement) {
+        mvprintw(y++, start_col, "Placed: %s %s (press 'a' to apply)", placement->relation, placement->target);
+    }
+    if (pending && pending->set_rotation) {
+        mvprintw(y++, start_col, "Rotating: %s, reflect %s (press 'a' to apply)", rotation_name(pending->rotation),
+                 reflection_name(pending->rotation));
+    }
+    if (pending && pending->scale > 0.0) {
+        mvprintw(y++, start_col, "Scaling: %.2f, filter %s (press 'a' to apply)", pending->scale, filter_for_scale(pending->scale));
+    }
+    if (screen_note[0] != '\0') {
+        mvprintw(y++, start_col, "%.*s", cols - start_col - 2, screen_note);
     }
     y++;
 
@@ -207,7 +458,7 @@ void draw_right_panel(const Display *display, AppState state, int mode_highlight
     for (int i = 0; i < list_view_height && (mode_scroll + i) < display->mode_count; i++) {
         int item_index = mode_scroll + i;
         if (item_index == mode_highlight) wattron(stdscr, modes_active ? A_REVERSE : A_BOLD);
-        mvprintw(mode_y + i, mode_col + 2, "%dx%d", display->modes[item_index].width, display->modes[item_index].height);
+        mvprintw(mode_y + i, mode_col + 2, "%.15s", display->modes[item_index].name);
         if (item_index == mode_highlight) wattroff(stdscr, modes_active ? A_REVERSE : A_BOLD);
     }
     if (!modes_active && state == STATE_RATE_SELECT) wattroff(stdscr, A_DIM);
@@ -225,23 +476,52 @@ void draw_right_panel(const Display *display, AppState state, int mode_highlight
     for (int i = 0; i < list_view_height && (rate_scroll + i) < selected_mode->rate_count; i++) {
         int item_index = rate_scroll + i;
         if (item_index == rate_highlight) wattron(stdscr, A_REVERSE);
-        mvprintw(rate_y + i, rate_col + 2, "%.2fHz%s%s", selected_mode->refresh_rates[item_index].rate, selected_mode->refresh_rates[item_index].is_current ? "*" : "", selected_mode->refresh_rates[item_index].is_preferred ? "+" : "");
+        const RefreshRate *r = &selected_mode->refresh_rates[item_index];
+        // Exact rates get a third decimal, which tells apart e.g. 59.94 and 59.95
+        mvprintw(rate_y + i, rate_col + 2, r->has_timing ? "%.3fHz%s%s" : "%.2fHz%s%s", r->rate, r->is_current ? "*" : "", r->is_preferred ? "+" : "");
         if (item_index == rate_highlight) wattroff(stdscr, A_REVERSE);
     }
 }
 
 /**
- * @brief Toggles a display on or off using xrandr.
- * @param display The target display.
+ * @brief Checks up front whether a dark output could be turned on next to the lit ones,
+ * i.e. whether there'd still be a CRTC for everything.
+ * @param note Filled with the outputs it can't be on together with, "" if it can.
  */
-void toggle_display_power(const Display* display) {
-    char command[256];
-    if (display->is_active) {
-        snprintf(command, sizeof(command), "xrandr --output %s --off", display->name);
-    } else {
-        // --auto will pick the preferred mode and turn it on.
-        snprintf(command, sizeof(command), "xrandr --output %s --auto", display->name);
+void crtc_conflict_note(const Display *display, const Display *displays, int display_count, char *note, size_t note_size) {
+    note[0] = '\0';
+    if (display->is_active || display->possible_crtcs == 0) return;
+
+    Transaction t;
+    transaction_init(&t);
+    OutputChange *c = transaction_output(&t, display->name);
+    if (c) {
+        c->auto_mode = 1;
+        // No screen limits: this is only about CRTCs, sizes may not be decoded yet
+        if (transaction_validate(&t, displays, display_count, NULL, note, note_size)) note[0] = '\0';
     }
+    transaction_free(&t);
+}
+
+/**
+ * @brief Runs a transaction as one xrandr call, outside of ncurses so its output is visible.
+ * Layouts that can't fit the screen or its CRTCs are turned down first, without leaving ncurses.
+ * @param t The batched changes to apply (CRTC choices get added to it).
+ * @param displays The current snapshot, to check the layout against (its modes get decoded).
+ * @param screen The screen's framebuffer limits.
+ * @param status Filled with the reason if the layout was turned down.
+ * @return True if xrandr was run (the caller should reload).
+ */
+bool run_transaction(Transaction* t, Display *displays, int display_count, const ScreenInfo *screen,
+                     char *status, size_t status_size) {
+    // Sizes of --auto modes come from the mode lists
+    if (!transaction_ensure_modes(t, displays, display_count)) return false;
+    if (!transaction_follow_tiles(t, displays, display_count)) return false;
+    if (!transaction_validate(t, displays, display_count, screen, status, status_size)) return false;
+    if (!transaction_assign_crtcs(t, displays, display_count)) return false;
+    transaction_plan_screen(t, displays, display_count, screen);
+    char *command = transaction_command(t);
+    if (command == NULL) return false;
 
     // Temporarily leave ncurses to run the command and see its output
     def_prog_mode(); // Save ncurses terminal state
@@ -253,49 +533,203 @@ void toggle_display_power(const Display* display) {
     getchar(); // Wait for user
 
     reset_prog_mode(); // Restore terminal state
+    free(command);
+    return true;
 }
 
 /**
- * @brief Executes the xrandr command to apply the selected position.
- * @param source_display The display to move.
- * @param target_display The reference display.
- * @param direction The relative position (e.g., "left-of").
+ * @brief Wires a GPU whose outputs don't show yet to the one driving the screen (reverse
+ * PRIME), then turns on the outputs that came up. Those need a second xrandr call, as the
+ * first one can't know about them.
+ * @return True if xrandr was run (see run_transaction()).
  */
-void apply_position_settings(const Display* source_display, const Display* target_display, const char* direction) {
-    char command[256];
-    snprintf(command, sizeof(command), "xrandr --output %s --%s %s --auto",
-             source_display->name, direction, target_display->name);
+bool wire_default_provider(Display *displays, int display_count, const ScreenInfo *screen,
+                           char *status, size_t status_size) {
+    int provider_count;
+    Provider *providers = read_providers(&provider_count);
+    const Provider *sink, *source;
+    if (!providers_default_wiring(providers, provider_count, &sink, &source)) {
+        snprintf(status, status_size, "No GPU left to wire up");
+        free(providers);
+        return false;
+    }
 
-    // Temporarily leave ncurses to run the command
-    def_prog_mode();
-    endwin();
+    bool ran = false;
+    Transaction t;
+    transaction_init(&t);
+    if (transaction_provider(&t, sink->id, 0, source->id)) {
+        ran = run_transaction(&t, displays, display_count, screen, status, status_size);
+    }
+    transaction_free(&t);
+    if (ran) {
+        snprintf(status, status_size, "Wired %s to %s", sink->name, source->name);
+        int wired_count;
+        ScreenInfo wired_screen;
+        Display *wired = parse_xrandr_output(&wired_count, &wired_screen, true);
+        transaction_init(&t);
+        if (wired && transaction_light_new_outputs(&t, displays, display_count, wired, wired_count) > 0) {
+            run_transaction(&t, wired, wired_count, &wired_screen, status, status_size);
+        }
+        transaction_free(&t);
+        free_displays(wired, wired_count);
+    }
+    free(providers);
+    return ran;
+}
 
-    printf("Running command: %s\n", command);
-    system(command);
-    printf("Press Enter to return to the application.");
-    getchar();
+/**
+ * @brief Toggles a display on or off using xrandr.
+ * @param display The target display.
+ * @return True if xrandr was run (see run_transaction()).
+ */
+bool toggle_display_power(const Display* display, Display *displays, int display_count, const ScreenInfo *screen,
+                          char *status, size_t status_size) {
+    bool ran = false;
+    Transaction t;
+    transaction_init(&t);
+    OutputChange *c = transaction_output(&t, display->name);
+    if (c) {
+        if (display->is_active) {
+            c->off = 1;
+        } else {
+            // --auto will pick the preferred mode and turn it on.
+            c->auto_mode = 1;
+        }
+        ran = run_transaction(&t, displays, display_count, screen, status, status_size);
+    }
+    transaction_free(&t);
+    return ran;
+}
 
-    reset_prog_mode();
+/**
+ * @brief Adds every change of one transaction to another.
+ * @return False if memory ran out.
+ */
+bool copy_changes(Transaction *to, const Transaction *from) {
+    for (int i = 0; i < from->output_count; i++) {
+        OutputChange *c = transaction_output(to, from->outputs[i].name);
+        if (c == NULL) return false;
+        *c = from->outputs[i];
+    }
+    return true;
 }
 
 /**
- * @brief Executes the xrandr command to set a display as primary.
- * @param display The display to set as primary.
+ * @brief Decodes the mode lists solving the placements on top of the changes needs: those the
+ * changes need (see transaction_ensure_modes()), and those of every output a placement names.
+ * Placed dark outputs come on with their preferred mode, and mirrors look for a mode they share.
+ * @return False if memory ran out.
  */
-void set_primary_display(const Display* display) {
-    char command[256];
-    snprintf(command, sizeof(command), "xrandr --output %s --primary", display->name);
+static bool ensure_pending_modes(const Layout *layout, const Transaction *changes, Display *displays,
+                                 int display_count) {
+    for (int i = 0; i < layout->count; i++) {
+        const LayoutConstraint *lc = &layout->constraints[i];
+        for (int j = 0; j < display_count; j++) {
+            if (strcmp(displays[j].name, lc->output) != 0 && strcmp(displays[j].name, lc->target) != 0) continue;
+            if (!display_ensure_modes(&displays[j])) return false;
+        }
+    }
+    return transaction_ensure_modes(changes, displays, display_count);
+}
 
-    // Temporarily leave ncurses to run the command
-    def_prog_mode();
-    endwin();
+/**
+ * @brief Describes the screen the pending placements and changes would leave, and what its
+ * framebuffer costs at 32 bits per pixel, next to what it is now.
+ * @param note Filled with the description, "" if nothing is pending.
+ */
+void describe_pending_screen(const Layout *layout, const Transaction *changes, Display *displays, int display_count,
+                             const ScreenInfo *screen, char *note, size_t size) {
+    note[0] = '\0';
+    if (layout->count == 0 && changes->output_count == 0) return;
+    Transaction t;
+    transaction_init(&t);
+    char reason[STATUS_LEN];
+    int width, height;
+    if (ensure_pending_modes(layout, changes, displays, display_count) && copy_changes(&t, changes) && layout_solve(layout, displays, display_count, &t, reason, sizeof(reason)) &&
+        transaction_framebuffer(&t, displays, display_count, &width, &height)) {
+        snprintf(note, size, "Screen after 'a': %dx%d, %.1f MiB (now %dx%d, %.1f MiB)", width, height,
+                 width * (double)height * 4.0 / (1024.0 * 1024.0), screen->width, screen->height,
+                 screen->width * (double)screen->height * 4.0 / (1024.0 * 1024.0));
+    }
+    transaction_free(&t);
+}
 
-    printf("Running command: %s\n", command);
-    system(command);
-    printf("Press Enter to return to the application.");
-    getchar();
+/**
+ * @brief Solves every placement made in the position panel into absolute positions
+ * and applies them all in one xrandr call.
+ * @param layout The placements.
+ * @return True if xrandr was run (see run_transaction()).
+ */
+bool apply_layout(const Layout *layout, const Transaction *changes, Display *displays, int display_count,
+                  const ScreenInfo *screen, char *status, size_t status_size) {
+    bool ran = false;
+    Transaction t;
+    transaction_init(&t);
+    // Outputs that get turned on are placed with the size of their preferred mode
+    // Rotations and scales change sizes, so they're in before the layout is solved
+    if (ensure_pending_modes(layout, changes, displays, display_count) && copy_changes(&t, changes) && layout_solve(layout, displays, display_count, &t, status, status_size)) {
+        ran = run_transaction(&t, displays, display_count, screen, status, status_size);
+    }
+    transaction_free(&t);
+    return ran;
+}
+
+/**
+ * @brief The change waiting for an output in a transaction, NULL if there is none.
+ */
+const OutputChange* find_pending_change(const Transaction *t, const char *name) {
+    for (int i = 0; i < t->output_count; i++) {
+        if (strcmp(t->outputs[i].name, name) == 0) return &t->outputs[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief The next rotation the display supports after the one in rotation, a quarter turn
+ * further each time. The reflection is kept.
+ */
+unsigned int next_rotation(const Display *display, unsigned int rotation) {
+    unsigned int supported = display->rotations ? display->rotations : ROTATION_MASK;
+    for (int step = 1; step <= 4; step++) {
+        for (int i = 0; i < 4; i++) {
+            if (!(rotation & (ROTATION_NORMAL << i))) continue;
+            unsigned int next = ROTATION_NORMAL << ((i + step) % 4);
+            if (supported & next) return (rotation & REFLECT_MASK) | next;
+        }
+    }
+    return rotation;
+}
 
-    reset_prog_mode();
+/**
+ * @brief The next reflection the display supports (normal, x, y, xy), keeping the rotation.
+ */
+unsigned int next_reflection(const Display *display, unsigned int rotation) {
+    unsigned int supported = display->rotations ? display->rotations & REFLECT_MASK : REFLECT_MASK;
+    unsigned int reflection = rotation & REFLECT_MASK;
+    for (int step = 0; step < 4; step++) {
+        reflection = (reflection + REFLECT_X) & REFLECT_MASK;
+        if ((reflection & ~supported) == 0) break;
+    }
+    return (rotation & ROTATION_MASK) | reflection;
+}
+
+/**
+ * @brief Executes the xrandr command to set a display as primary.
+ * @param display The display to set as primary.
+ * @return True if xrandr was run (see run_transaction()).
+ */
+bool set_primary_display(const Display* display, Display *displays, int display_count, const ScreenInfo *screen,
+                         char *status, size_t status_size) {
+    bool ran = false;
+    Transaction t;
+    transaction_init(&t);
+    OutputChange *c = transaction_output(&t, display->name);
+    if (c) {
+        c->primary = 1;
+        ran = run_transaction(&t, displays, display_count, screen, status, status_size);
+    }
+    transaction_free(&t);
+    return ran;
 }
 
 /**
@@ -303,23 +737,21 @@ void set_primary_display(const Display* display) {
  * @param display The target display.
  * @param mode The target mode (resolution).
  * @param rate The target refresh rate.
+ * @return True if xrandr was run (see run_transaction()).
  */
-void apply_xrandr_settings(const Display* display, const Mode* mode, const RefreshRate* rate) {
-    char command[256];
-    snprintf(command, sizeof(command), "xrandr --output %s --mode %dx%d --rate %.2f",
-             display->name, mode->width, mode->height, rate->rate);
-
-    // Temporarily leave ncurses to run the command and see its output
-    def_prog_mode(); // Save ncurses terminal state
-    //somehow didn't work
-    endwin();        
-
-    printf("Running command: %s\n", command);
-    system(command); 
-    printf("Press Enter to return to the application.");
-    getchar(); // Wait for user 
-
-    reset_prog_mode(); // Restore terminal state
+bool apply_xrandr_settings(const Display* display, const Mode* mode, const RefreshRate* rate,
+                           Display *displays, int display_count, const ScreenInfo *screen,
+                           char *status, size_t status_size) {
+    bool ran = false;
+    Transaction t;
+    transaction_init(&t);
+    OutputChange *c = transaction_output(&t, display->name);
+    if (c) {
+        output_change_set_mode(c, mode, rate);
+        ran = run_transaction(&t, displays, display_count, screen, status, status_size);
+    }
+    transaction_free(&t);
+    return ran;
 }
 
 /**
@@ -350,41 +782,35 @@ void cleanup_display_data(Display *displays, int display_count, char **menu_item
 }
 
 /**
- * @brief Parses xrandr output and sets up all data structures for the TUI.
+ * @brief Builds the menu and connected-display lists, without taking ownership of displays.
  * @return True on success, false on failure.
  */
-bool setup_display_data(Display **displays, int *display_count, 
+bool fill_display_menus(Display *displays, int display_count,
                         char ***menu_items, int *num_items,
                         Display ***connected_displays, int *connected_count) {
-    *displays = parse_xrandr_output(display_count);
-    if (*displays == NULL) {
-        fprintf(stderr, "Failed to parse xrandr output. Is xrandr installed and in your PATH?\n");
-        return false;
-    }
-
+    // The other tiles of a tiled monitor go wherever its leader goes, so only the leader is listed
     *connected_count = 0;
-    for (int i = 0; i < *display_count; i++) {
-        if ((*displays)[i].connected) {
+    for (int i = 0; i < display_count; i++) {
+        if (displays[i].connected && !display_is_tile_follower(displays, display_count, &displays[i])) {
             (*connected_count)++;
         }
     }
 
     *menu_items = malloc((*connected_count + 1) * sizeof(char *));
-    *connected_displays = malloc(*connected_count * sizeof(Display*));
+    *connected_displays = malloc((*connected_count > 0 ? *connected_count : 1) * sizeof(Display*));
 
     if (*menu_items == NULL || *connected_displays == NULL) {
         fprintf(stderr, "Failed to allocate memory for menu.\n");
-        free_displays(*displays, *display_count);
         free(*menu_items);
         free(*connected_displays);
         return false;
     }
 
     int current_item = 0;
-    for (int i = 0; i < *display_count; i++) {
-        if ((*displays)[i].connected) {
-            (*menu_items)[current_item] = (*displays)[i].name;
-            (*connected_displays)[current_item] = &(*displays)[i];
+    for (int i = 0; i < display_count; i++) {
+        if (displays[i].connected && !display_is_tile_follower(displays, display_count, &displays[i])) {
+            (*menu_items)[current_item] = displays[i].name;
+            (*connected_displays)[current_item] = &displays[i];
             current_item++;
         }
     }
@@ -394,18 +820,321 @@ bool setup_display_data(Display **displays, int *display_count,
     return true;
 }
 
-int main() {
+/**
+ * @brief Builds the menu and connected-display lists for an already parsed snapshot.
+ * Takes ownership of displays: they are freed on failure.
+ * @return True on success, false on failure.
+ */
+bool build_display_menus(Display *displays, int display_count,
+                         char ***menu_items, int *num_items,
+                         Display ***connected_displays, int *connected_count) {
+    if (!fill_display_menus(displays, display_count, menu_items, num_items, connected_displays, connected_count)) {
+        free_displays(displays, display_count);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Parses xrandr output and sets up all data structures for the TUI.
+ * If a daemon is running, its warm snapshot is used instead of running xrandr.
+ * Fresh results from xrandr are also written to the snapshot cache for the next start.
+ * @param refresh Make the daemon re-query first (we just changed something).
+ * @return True on success, false on failure.
+ */
+bool setup_display_data(Display **displays, int *display_count, ScreenInfo *screen,
+                        char ***menu_items, int *num_items,
+                        Display ***connected_displays, int *connected_count,
+                        bool refresh) {
+    *displays = daemon_fetch_displays(refresh, display_count, screen);
+    if (*displays == NULL) {
+        *displays = parse_xrandr_output(display_count, screen, true);
+        if (*displays != NULL) {
+            snapshot_cache_save(*displays, *display_count, screen);
+        }
+    }
+    if (*displays == NULL) {
+        fprintf(stderr, "Failed to parse xrandr output. Is xrandr installed and in your PATH?\n");
+        return false;
+    }
+
+    return build_display_menus(*displays, *display_count, menu_items, num_items, connected_displays, connected_count);
+}
+
+/**
+ * @brief Applies the saved profile for the connected monitor set, unless it's already in effect.
+ * Runs without leaving ncurses, since this happens on its own rather than on a key press.
+ * @return True if a transaction was run (the caller should reload).
+ */
+bool auto_apply_profile(const ProfileStore *profiles, Display *displays, int display_count, const ScreenInfo *screen,
+                        char *status, size_t status_size) {
+    const Profile *profile = profile_store_find(profiles, monitor_set_fingerprint(displays, display_count));
+    if (profile == NULL || profile_matches_layout(profile, displays, display_count)) {
+        return false;
+    }
+
+    Transaction t;
+    transaction_init(&t);
+    bool applied = false;
+    char reason[STATUS_LEN];
+    if (!profile_to_transaction(profile, displays, display_count, &t)) {
+        snprintf(status, status_size, "Failed to apply profile '%s'", profile->name);
+    } else if (!transaction_validate(&t, displays, display_count, screen, reason, sizeof(reason))) {
+        snprintf(status, status_size, "Profile '%s' doesn't fit: %s", profile->name, reason);
+    } else if (!transaction_assign_crtcs(&t, displays, display_count)) {
+        snprintf(status, status_size, "Failed to apply profile '%s'", profile->name);
+    } else {
+        transaction_plan_screen(&t, displays, display_count, screen);
+        applied = transaction_apply(&t) == 0;
+        snprintf(status, status_size, applied ? "Applied profile '%s'" : "Failed to apply profile '%s'", profile->name);
+    }
+    transaction_free(&t);
+    return applied;
+}
+
+bool reload_display_data(Display **displays, int *display_count, ScreenInfo *screen,
+                         char ***menu_items, int *num_items,
+                         Display ***connected_displays, int *connected_count,
+                         const ProfileStore *profiles, char *status, size_t status_size);
+
+/**
+ * @brief Diffs the data that was just swapped in against the previous snapshot,
+ * then frees the previous one. If monitors were plugged or unplugged and a
+ * profile is saved for the new set, it is applied straight away.
+ * @param profiles Saved profiles, or NULL to skip auto-applying.
+ * @param status Filled with a short summary of what changed.
+ * @return True on success, false on failure.
+ */
+bool reconcile_display_data(Display *old_displays, int old_count, char **old_menu_items, Display **old_connected,
+                            Display **displays, int *display_count, ScreenInfo *screen,
+                            char ***menu_items, int *num_items,
+                            Display ***connected_displays, int *connected_count,
+                            const ProfileStore *profiles, char *status, size_t status_size) {
+    DisplayEvent *events = NULL;
+    int event_count = 0;
+    bool monitors_changed = false;
+    status[0] = '\0';
+    if (diff_displays(old_displays, old_count, *displays, *display_count, &events, &event_count)) {
+        if (event_count == 0) {
+            snprintf(status, status_size, "No changes");
+        } else {
+            format_display_event(&events[0], status, status_size);
+            if (event_count > 1) {
+                size_t len = strlen(status);
+                snprintf(status + len, status_size - len, " (+%d more)", event_count - 1);
+            }
+        }
+        for (int i = 0; i < event_count; i++) {
+            if (events[i].type == DISPLAY_EVENT_CONNECTED || events[i].type == DISPLAY_EVENT_DISCONNECTED) {
+                monitors_changed = true;
+            }
+        }
+        free(events);
+    }
+
+    cleanup_display_data(old_displays, old_count, old_menu_items, old_connected);
+
+    if (monitors_changed && profiles &&
+        auto_apply_profile(profiles, *displays, *display_count, screen, status, status_size)) {
+        char ignored[STATUS_LEN];
+        return reload_display_data(displays, display_count, screen, menu_items, num_items,
+                                   connected_displays, connected_count, NULL, ignored, sizeof(ignored));
+    }
+    return true;
+}
+
+/**
+ * @brief Re-parses xrandr and swaps in the new data, keeping the old snapshot
+ * alive just long enough to diff against it (see reconcile_display_data()).
+ * @param profiles Saved profiles, or NULL to skip auto-applying.
+ * @param status Filled with a short summary of what changed.
+ * @return True on success, false on failure (the old data is freed either way).
+ */
+bool reload_display_data(Display **displays, int *display_count, ScreenInfo *screen,
+                         char ***menu_items, int *num_items,
+                         Display ***connected_displays, int *connected_count,
+                         const ProfileStore *profiles, char *status, size_t status_size) {
+    Display *old_displays = *displays;
+    int old_count = *display_count;
+    char **old_menu_items = *menu_items;
+    Display **old_connected = *connected_displays;
+
+    if (!setup_display_data(displays, display_count, screen, menu_items, num_items, connected_displays, connected_count, true)) {
+        cleanup_display_data(old_displays, old_count, old_menu_items, old_connected);
+        return false;
+    }
+
+    return reconcile_display_data(old_displays, old_count, old_menu_items, old_connected,
+                                  displays, display_count, screen, menu_items, num_items,
+                                  connected_displays, connected_count, profiles, status, status_size);
+}
+
+/**
+ * @brief Swaps the live result of the background query in for the cached snapshot we started with
+ * (or for the outputs streamed so far, see main()).
+ * If the query failed, the cached data simply stays on screen.
+ * @return True on success, false on failure.
+ */
+bool adopt_live_display_data(XrandrQuery *query,
+                             Display **displays, int *display_count, ScreenInfo *screen,
+                             char ***menu_items, int *num_items,
+                             Display ***connected_displays, int *connected_count,
+                             const ProfileStore *profiles, char *status, size_t status_size) {
+    // When streaming there is no snapshot of our own yet; the menus point into the parser.
+    bool streamed = *displays == NULL;
+    int live_count = 0;
+    ScreenInfo live_screen;
+    Display *live = xrandr_query_finish(query, &live_count, &live_screen);
+    if (live == NULL) {
+        if (streamed) {
+            fprintf(stderr, "Failed to parse xrandr output. Is xrandr installed and in your PATH?\n");
+            return false;
+        }
+        snprintf(status, status_size, "Could not query xrandr; showing cached data");
+        return true;
+    }
+    snapshot_cache_save(live, live_count, &live_screen);
+    *screen = live_screen;
+
+    Display *old_displays = *displays;
+    int old_count = *display_count;
+    char **old_menu_items = *menu_items;
+    Display **old_connected = *connected_displays;
+
+    *displays = live;
+    *display_count = live_count;
+    if (!build_display_menus(live, live_count, menu_items, num_items, connected_displays, connected_count)) {
+        cleanup_display_data(old_displays, old_count, old_menu_items, old_connected);
+        return false;
+    }
+    if (!reconcile_display_data(old_displays, old_count, old_menu_items, old_connected,
+                                displays, display_count, screen, menu_items, num_items,
+                                connected_displays, connected_count, NULL, status, status_size)) {
+        return false;
+    }
+    if (streamed) {
+        status[0] = '\0'; // Everything would just show up as "connected"
+    }
+
+    // The cache can't be trusted to decide on profiles, so this is the real startup check.
+    if (profiles && auto_apply_profile(profiles, *displays, *display_count, screen, status, status_size)) {
+        char ignored[STATUS_LEN];
+        return reload_display_data(displays, display_count, screen, menu_items, num_items,
+                                   connected_displays, connected_count, NULL, ignored, sizeof(ignored));
+    }
+    return true;
+}
+
+/**
+ * @brief Finds the row of a monitor after the data was reloaded, so the selection follows
+ * the monitor rather than the row (or the connector, if it moved to another one).
+ * @return The row, or 0 if the monitor is gone.
+ */
+int find_monitor_row(Display **connected_displays, int connected_count, uint64_t identity, const char *name) {
+    int by_name = 0;
+    for (int i = 0; i < connected_count; i++) {
+        if (display_identity(connected_displays[i]) == identity) return i;
+        if (strcmp(connected_displays[i]->name, name) == 0) by_name = i;
+    }
+    return by_name;
+}
+
+static double elapsed_ms(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000.0 + (now.tv_nsec - since->tv_nsec) / 1e6;
+}
+
+/**
+ * @brief Saves the current layout as the profile for the connected monitor set.
+ * The profile is named after the outputs, e.g. "eDP-1+HDMI-1".
+ */
+void save_current_profile(ProfileStore *profiles, const Display *displays, int display_count,
+                          char *status, size_t status_size) {
+    char name[64] = "";
+    size_t len = 0;
+    for (int i = 0; i < display_count; i++) {
+        if (!displays[i].connected) continue;
+        len += snprintf(name + len, sizeof(name) - len, "%s%s", len ? "+" : "", displays[i].name);
+        if (len >= sizeof(name)) { name[sizeof(name) - 1] = '\0'; break; }
+    }
+
+    const Profile *profile = profile_store_put(profiles, name, displays, display_count);
+    if (profile && profile_store_save(profiles)) {
+        snprintf(status, status_size, "Saved profile '%s'", profile->name);
+    } else {
+        snprintf(status, status_size, "Failed to save profile");
+    }
+}
+
+int main(int argc, char **argv) {
+    // Any argument means a scripted call; keep ncurses out of that path entirely.
+    if (argc > 1) {
+        return cli_main(argc, argv);
+    }
+
+    struct timespec start_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    double first_frame_ms = -1.0;
+
     Display *displays = NULL;
     int display_count = 0;
+    ScreenInfo screen;
+    memset(&screen, 0, sizeof(screen));
     char **menu_items = NULL;
     int num_items = 0;
     Display **connected_displays = NULL;
     int connected_count = 0;
-
-    if (!setup_display_data(&displays, &display_count, &menu_items, &num_items, &connected_displays, &connected_count)) {
+    char status[STATUS_LEN] = "";
+    ProfileStore profiles;
+
+    // A warm daemon is live and fast. Otherwise draw the first frame from the
+    // cached snapshot and let xrandr run in the background (MYRANDR_NO_CACHE=1 skips that).
+    XrandrQuery live_query;
+    bool live_pending = false;
+    bool from_cache = false;
+    displays = daemon_fetch_displays(false, &display_count, &screen);
+    if (displays == NULL && getenv("MYRANDR_NO_CACHE") == NULL) {
+        displays = snapshot_cache_load(&display_count, &screen);
+        if (displays != NULL && !(live_pending = xrandr_query_start(&live_query))) {
+            free_displays(displays, display_count);
+            displays = NULL;
+        }
+        from_cache = displays != NULL;
+    }
+    // Nothing to show yet: run xrandr in the background anyway and draw outputs as they're parsed.
+    bool streaming = false;
+    int streamed_count = 0;
+    const Display *streamed_base = NULL;
+    if (displays == NULL) {
+        streaming = live_pending = xrandr_query_start(&live_query);
+    }
+    if (displays != NULL) {
+        if (!build_display_menus(displays, display_count, &menu_items, &num_items, &connected_displays, &connected_count)) {
+            return 1;
+        }
+    } else if (streaming) {
+        if (!fill_display_menus(NULL, 0, &menu_items, &num_items, &connected_displays, &connected_count)) {
+            return 1;
+        }
+        snprintf(status, sizeof(status), "Querying xrandr...");
+    } else if (!setup_display_data(&displays, &display_count, &screen, &menu_items, &num_items, &connected_displays, &connected_count, false)) {
         return 1;
     }
 
+    if (!profile_store_load(&profiles, NULL)) {
+        fprintf(stderr, "Failed to load profiles.\n");
+    }
+    // Same as on hotplug: if this monitor set has a saved layout, put it in place first.
+    // Without live data yet this waits until it is in (see adopt_live_display_data()).
+    if (!live_pending && auto_apply_profile(&profiles, displays, display_count, &screen, status, sizeof(status))) {
+        char ignored[STATUS_LEN];
+        if (!reload_display_data(&displays, &display_count, &screen, &menu_items, &num_items, &connected_displays, &connected_count, NULL, ignored, sizeof(ignored))) {
+            profile_store_free(&profiles);
+            return 1;
+        }
+    }
+
     AppState state = STATE_MONITOR_SELECT;
     int monitor_highlight = 0;
     int mode_highlight = 0;
@@ -422,6 +1151,25 @@ int main() {
     int position_target_count = 0;
     const char *position_directions[] = {"right-of", "left-of", "above", "below", "same-as"};
     const int position_direction_count = sizeof(position_directions) / sizeof(char*);
+    // Placements from the position panel, applied together with 'a'
+    Layout pending_layout;
+    layout_init(&pending_layout);
+    // Rotations and reflections ('t', 'f'), applied with the placements
+    Transaction pending_changes;
+    transaction_init(&pending_changes);
+    // Positions being moved on the layout map ('v'), applied with Enter
+    LayoutMap layout_map = {NULL, 0, 0, 0, false};
+    static const int map_steps[] = {1, 10, 100, 1000};
+    // Outputs picked for the video wall ('g'), as indexes into displays in wall order
+    int *wall_outputs = NULL;
+    int wall_count = 0;
+    GridSpec wall_grid = {1, 1, 0, 0, GRID_ROWS_FIRST};
+    // Every key of the main screen, over everything else ('?')
+    bool show_keys = false;
+    // RandR 1.5 monitors ('x'): as xrandr listed them, and the copy being edited
+    LogicalMonitor *monitors_before = NULL, *monitors_after = NULL;
+    int monitors_before_count = 0, monitors_after_count = 0;
+    int logical_highlight = 0;
 
     init_ncurses();
 
@@ -438,11 +1186,36 @@ int main() {
                 draw_resize_message();
             } else {
                 int monitor_view_height = rows - 4; // border + title
-                draw_border(rows, cols, state);
-                draw_monitor_list(connected_displays, connected_count, num_items, monitor_highlight, state == STATE_MONITOR_SELECT, monitor_scroll, monitor_view_height);
-
-                if (monitor_highlight < connected_count) {
-                    draw_right_panel(connected_displays[monitor_highlight], state,
+                draw_border(rows, cols, state, status);
+                draw_monitor_list(connected_displays, connected_count, num_items, monitor_highlight,
+                                  state == STATE_MONITOR_SELECT || state == STATE_VIDEO_WALL, monitor_scroll, monitor_view_height);
+
+                if (state == STATE_VIDEO_WALL) {
+                    draw_wall_panel(&wall_grid, displays, wall_outputs, wall_count, rows, cols);
+                } else if (state == STATE_LOGICAL_MONITORS) {
+                    Transaction edits;
+                    transaction_init(&edits);
+                    logical_monitors_diff(monitors_before, monitors_before_count, monitors_after, monitors_after_count, &edits);
+                    draw_logical_monitors_panel(monitors_after, monitors_after_count, logical_highlight, edits.monitor_count,
+                                                rows, cols);
+                    transaction_free(&edits);
+                } else if (state == STATE_LAYOUT_MAP) {
+                    int start_col = cols / 3;
+                    const PlannedOutput *p = &layout_map.planned[layout_map.selected];
+                    mvvline(1, start_col - 2, ACS_VLINE, rows - 2);
+                    mvprintw(2, start_col, "Layout: %s %dx%d at +%d+%d, step %dpx, snap %s", displays[layout_map.selected].name,
+                             p->width, p->height, p->x_offset, p->y_offset, layout_map.step, layout_map.snap ? "on" : "off");
+                    draw_layout_map(&layout_map, displays, 4, start_col, rows - 6, cols - start_col - 2);
+                } else if (monitor_highlight < connected_count) {
+                    char crtc_note[STATUS_LEN];
+                    char screen_note[STATUS_LEN];
+                    crtc_conflict_note(connected_displays[monitor_highlight], displays, display_count, crtc_note, sizeof(crtc_note));
+                    describe_pending_screen(&pending_layout, &pending_changes, displays, display_count, &screen,
+                                            screen_note, sizeof(screen_note));
+                    draw_right_panel(connected_displays[monitor_highlight], crtc_note,
+                                     layout_find(&pending_layout, connected_displays[monitor_highlight]->name),
+                                     find_pending_change(&pending_changes, connected_displays[monitor_highlight]->name),
+                                     screen_note, state,
                                      mode_highlight, rate_highlight, mode_scroll, rate_scroll,
                                      position_target_displays, position_target_count, pos_target_highlight,
                                      (const char**)position_directions, position_direction_count, pos_direction_highlight, pos_panel_focus,
@@ -452,27 +1225,312 @@ int main() {
                 }
             }
             refresh();
+            if (show_keys && rows >= MIN_ROWS && cols >= MIN_COLS) draw_keys_overlay(rows, cols);
             needs_redraw = false;
+            if (first_frame_ms < 0 && (connected_count > 0 || !live_pending)) {
+                first_frame_ms = elapsed_ms(&start_time);
+            }
         }
 
         // --- Input Handling ---
+        // While the live query is running we wake up regularly to check on it.
+        timeout(live_pending ? LIVE_POLL_MS : -1);
         int ch = getch(); // This now blocks until a key is pressed or window is resized.
 
+        if (live_pending) {
+            // A key press acts on live data, so finish the query before handling it.
+            if (ch != ERR || xrandr_query_read(&live_query) != 0) {
+                live_pending = false;
+                uint64_t selected_identity = 0;
+                char selected_name[32] = "";
+                if (monitor_highlight < connected_count) {
+                    selected_identity = display_identity(connected_displays[monitor_highlight]);
+                    snprintf(selected_name, sizeof(selected_name), "%s", connected_displays[monitor_highlight]->name);
+                }
+                if (!adopt_live_display_data(&live_query, &displays, &display_count, &screen, &menu_items, &num_items, &connected_displays, &connected_count, &profiles, status, sizeof(status))) {
+                    cleanup_ncurses();
+                    fprintf(stderr, "Failed to set up live xrandr data.\n");
+                    return 1;
+                }
+                if (selected_name[0] != '\0') {
+                    monitor_highlight = find_monitor_row(connected_displays, connected_count, selected_identity, selected_name);
+                    monitor_scroll = 0;
+                } else if (monitor_highlight >= num_items) {
+                    monitor_highlight = 0; monitor_scroll = 0;
+                }
+                needs_redraw = true;
+            } else if (streaming && (live_query.parser.complete_count != streamed_count ||
+                                     live_query.parser.displays != streamed_base)) {
+                // More outputs are done (or the parser's array moved): rebuild the menus on top of it
+                free(menu_items);
+                free(connected_displays);
+                streamed_count = live_query.parser.complete_count;
+                streamed_base = live_query.parser.displays;
+                if (!fill_display_menus(live_query.parser.displays, streamed_count, &menu_items, &num_items, &connected_displays, &connected_count)) {
+                    cleanup_ncurses();
+                    return 1;
+                }
+                needs_redraw = true;
+            }
+            if (ch == ERR) continue;
+        }
+
+        if (show_keys && ch != KEY_RESIZE) {
+            show_keys = false;
+            needs_redraw = true;
+            continue;
+        }
+
+        if (state == STATE_LAYOUT_MAP && ch != 'q' && ch != 'Q' && ch != KEY_RESIZE) {
+            // Moves only change the local copy; Enter sends all of them as one apply
+            int step_index = 0;
+            while (step_index < 3 && map_steps[step_index] != layout_map.step) step_index++;
+            switch (ch) {
+                case KEY_LEFT: case 'h': layout_map_nudge(&layout_map, -1, 0); break;
+                case KEY_RIGHT: case 'l': layout_map_nudge(&layout_map, 1, 0); break;
+                case KEY_UP: case 'k': layout_map_nudge(&layout_map, 0, -1); break;
+                case KEY_DOWN: case 'j': layout_map_nudge(&layout_map, 0, 1); break;
+                case 9: layout_map_select_next(&layout_map); break;
+                case '+': case '=': layout_map.step = map_steps[step_index < 3 ? step_index + 1 : 3]; break;
+                case '-': layout_map.step = map_steps[step_index > 0 ? step_index - 1 : 0]; break;
+                case 's': case 'S': layout_map.snap = !layout_map.snap; break;
+                case 'v': case 'V': case 27: // Esc
+                    layout_map_free(&layout_map);
+                    state = STATE_MONITOR_SELECT;
+                    break;
+                case 10: { // Enter
+                    Transaction t;
+                    transaction_init(&t);
+                    // Scales and rotations waiting for 'a' go along, the map was drawn with them
+                    bool ran = copy_changes(&t, &pending_changes) &&
+                               layout_map_commit(&layout_map, displays, display_count, &t) && t.output_count > 0 &&
+                               run_transaction(&t, displays, display_count, &screen, status, sizeof(status));
+                    transaction_free(&t);
+                    if (ran) {
+                        transaction_free(&pending_changes);
+                        transaction_init(&pending_changes);
+                    }
+                    layout_map_free(&layout_map);
+                    state = STATE_MONITOR_SELECT;
+                    if (ran && !reload_display_data(&displays, &display_count, &screen, &menu_items, &num_items, &connected_displays, &connected_count, &profiles, status, sizeof(status))) {
+                        cleanup_ncurses();
+                        fprintf(stderr, "Failed to re-parse xrandr data after moving outputs.\n");
+                        return 1;
+                    }
+                    if (ran) {
+                        monitor_highlight = 0; monitor_scroll = 0;
+                    }
+                    break;
+                }
+            }
+            needs_redraw = true;
+            continue;
+        }
+
+        if (state == STATE_LOGICAL_MONITORS && ch != 'q' && ch != 'Q' && ch != KEY_RESIZE) {
+            // Edits only change the copy; Enter sends them, with whatever waits for 'a', as one apply
+            int step = 64;
+            switch (ch) {
+                case KEY_DOWN: case 'j':
+                    if (logical_highlight + 1 < monitors_after_count) logical_highlight++;
+                    break;
+                case KEY_UP: case 'k':
+                    if (logical_highlight > 0) logical_highlight--;
+                    break;
+                case 's': case 'S':
+                    if (logical_highlight < monitors_after_count &&
+                        !logical_monitors_halve(&monitors_after, &monitors_after_count, logical_highlight)) {
+                        snprintf(status, sizeof(status), "Can't split %s", monitors_after[logical_highlight].name);
+                    }
+                    break;
+                case '<': case ',': case '>': case '.':
+                    if (logical_highlight < monitors_after_count &&
+                        !logical_monitors_widen(monitors_after, monitors_after_count, logical_highlight,
+                                                ch == '<' || ch == ',' ? -step : step)) {
+                        snprintf(status, sizeof(status), "%s can't be resized, split it first",
+                                 monitors_after[logical_highlight].name);
+                    }
+                    break;
+                case 'd': case 'D':
+                    if (logical_highlight < monitors_after_count && monitors_after[logical_highlight].automatic) {
+                        snprintf(status, sizeof(status), "%s is the server's monitor for its output",
+                                 monitors_after[logical_highlight].name);
+                    } else if (logical_highlight < monitors_after_count) {
+                        logical_monitors_remove(monitors_after, &monitors_after_count, logical_highlight);
+                        if (logical_highlight > 0 && logical_highlight >= monitors_after_count) logical_highlight--;
+                    }
+                    break;
+                case 'x': case 'X': case 27: // Esc
+                    state = STATE_MONITOR_SELECT;
+                    break;
+                case 10: { // Enter
+                    Transaction t;
+                    transaction_init(&t);
+                    // Placements are solved in first, as apply_layout() does, so monitors can use where they land
+                    bool ran = ensure_pending_modes(&pending_layout, &pending_changes, displays, display_count) &&
+                               copy_changes(&t, &pending_changes) &&
+                               layout_solve(&pending_layout, displays, display_count, &t, status, sizeof(status)) &&
+                               logical_monitors_diff(monitors_before, monitors_before_count, monitors_after,
+                                                     monitors_after_count, &t) &&
+                               t.monitor_count > 0 &&
+                               run_transaction(&t, displays, display_count, &screen, status, sizeof(status));
+                    transaction_free(&t);
+                    if (!ran) break;
+                    layout_free(&pending_layout);
+                    transaction_free(&pending_changes);
+                    transaction_init(&pending_changes);
+                    state = STATE_MONITOR_SELECT;
+                    free(position_target_displays);
+                    position_target_displays = NULL;
+                    if (!reload_display_data(&displays, &display_count, &screen, &menu_items, &num_items, &connected_displays, &connected_count, &profiles, status, sizeof(status))) {
+                        cleanup_ncurses();
+                        fprintf(stderr, "Failed to re-parse xrandr data after changing monitors.\n");
+                        return 1;
+                    }
+                    monitor_highlight = 0; monitor_scroll = 0;
+                    break;
+                }
+            }
+            needs_redraw = true;
+            continue;
+        }
+
+        if (state == STATE_VIDEO_WALL) {
+            // j/k, q and resizes go on to the main switch below
+            bool handled = true;
+            switch (ch) {
+                case ' ':
+                    if (monitor_highlight < connected_count) {
+                        int index = (int)(connected_displays[monitor_highlight] - displays);
+                        int at = 0;
+                        while (at < wall_count && wall_outputs[at] != index) at++;
+                        if (at < wall_count) {
+                            memmove(&wall_outputs[at], &wall_outputs[at + 1], (wall_count - at - 1) * sizeof(int));
+                            wall_count--;
+                        } else {
+                            wall_outputs[wall_count++] = index;
+                        }
+                    }
+                    break;
+                case ']': wall_grid.columns++; break;
+                case '[': if (wall_grid.columns > 1) wall_grid.columns--; break;
+                case 'b': wall_grid.bezel_x += 10; wall_grid.bezel_y += 10; break;
+                case 'B':
+                    wall_grid.bezel_x = wall_grid.bezel_x >= 10 ? wall_grid.bezel_x - 10 : 0;
+                    wall_grid.bezel_y = wall_grid.bezel_y >= 10 ? wall_grid.bezel_y - 10 : 0;
+                    break;
+                case 'o': case 'O':
+                    wall_grid.order = wall_grid.order == GRID_ROWS_FIRST ? GRID_COLUMNS_FIRST : GRID_ROWS_FIRST;
+                    break;
+                case 'g': case 'G': case 27: // Esc
+                    state = STATE_MONITOR_SELECT;
+                    break;
+                case 10: { // Enter
+                    Transaction t;
+                    transaction_init(&t);
+                    CommonMode mode;
+                    char reason[STATUS_LEN];
+                    bool ran = false;
+                    if (!layout_grid(&wall_grid, displays, wall_outputs, wall_count, &t, &mode, reason, sizeof(reason))) {
+                        snprintf(status, sizeof(status), "%s", reason);
+                    } else {
+                        ran = run_transaction(&t, displays, display_count, &screen, status, sizeof(status));
+                    }
+                    transaction_free(&t);
+                    if (!ran) break;
+                    state = STATE_MONITOR_SELECT;
+                    free(position_target_displays);
+                    position_target_displays = NULL;
+                    if (!reload_display_data(&displays, &display_count, &screen, &menu_items, &num_items, &connected_displays, &connected_count, &profiles, status, sizeof(status))) {
+                        cleanup_ncurses();
+                        fprintf(stderr, "Failed to re-parse xrandr data after setting up the wall.\n");
+                        return 1;
+                    }
+                    monitor_highlight = 0; monitor_scroll = 0;
+                    break;
+                }
+                default:
+                    handled = false;
+                    break;
+            }
+            // The wall gets as many rows as the picked outputs need
+            int filled = wall_count > 0 ? wall_count : 1;
+            wall_grid.rows = (filled + wall_grid.columns - 1) / wall_grid.columns;
+            if (handled) {
+                needs_redraw = true;
+                continue;
+            }
+        }
+
         switch (ch) {
             case 'q':
             case 'Q':
                 goto end_loop;
 
+            case '?':
+                if (state == STATE_MONITOR_SELECT) {
+                    show_keys = true;
+                    needs_redraw = true;
+                }
+                break;
+
+            case 'g':
+            case 'G':
+                if (state == STATE_MONITOR_SELECT) {
+                    // Finding the mode they have in common needs every mode list
+                    displays_ensure_modes(displays, display_count);
+                    free(wall_outputs);
+                    wall_count = 0;
+                    wall_outputs = malloc((display_count > 0 ? display_count : 1) * sizeof(int));
+                    if (wall_outputs == NULL) {
+                        snprintf(status, sizeof(status), "Out of memory.");
+                    } else {
+                        state = STATE_VIDEO_WALL;
+                    }
+                    needs_redraw = true;
+                }
+                break;
+
+            case 'x':
+            case 'X':
+                if (state == STATE_MONITOR_SELECT) {
+                    free(monitors_before);
+                    free(monitors_after);
+                    monitors_before = read_logical_monitors(&monitors_before_count);
+                    monitors_after = NULL;
+                    monitors_after_count = 0;
+                    if (monitors_before_count > 0) monitors_after = malloc(monitors_before_count * sizeof(LogicalMonitor));
+                    if (monitors_after) {
+                        memcpy(monitors_after, monitors_before, monitors_before_count * sizeof(LogicalMonitor));
+                        monitors_after_count = monitors_before_count;
+                    }
+                    logical_highlight = 0;
+                    state = STATE_LOGICAL_MONITORS;
+                    needs_redraw = true;
+                }
+                break;
+
+            case 'v':
+            case 'V':
+                if (state == STATE_MONITOR_SELECT && monitor_highlight < connected_count) {
+                    int selected = (int)(connected_displays[monitor_highlight] - displays);
+                    if (layout_map_init(&layout_map, &pending_changes, displays, display_count, selected)) {
+                        state = STATE_LAYOUT_MAP;
+                        needs_redraw = true;
+                    }
+                }
+                break;
+
             case 'o':
             case 'O':
                 if (state == STATE_MONITOR_SELECT && monitor_highlight < connected_count) {
                     Display* selected_display = connected_displays[monitor_highlight];
-                    toggle_display_power(selected_display);
+                    bool ran = toggle_display_power(selected_display, displays, display_count, &screen, status, sizeof(status));
 
                     // Reparse and rebuild menus with the new/updated data
-                    cleanup_display_data(displays, display_count, menu_items, connected_displays);
                     free(position_target_displays);
-                    if (!setup_display_data(&displays, &display_count, &menu_items, &num_items, &connected_displays, &connected_count)) {
+                    position_target_displays = NULL;
+                    if (ran && !reload_display_data(&displays, &display_count, &screen, &menu_items, &num_items, &connected_displays, &connected_count, &profiles, status, sizeof(status))) {
                         cleanup_ncurses();
                         fprintf(stderr, "Failed to re-parse xrandr data after toggling display.\n");
                         return 1;
@@ -516,12 +1574,12 @@ int main() {
                 if (state == STATE_MONITOR_SELECT && monitor_highlight < connected_count) {
                     Display* selected_display = connected_displays[monitor_highlight];
                     if (!selected_display->is_primary) {
-                        set_primary_display(selected_display);
+                        bool ran = set_primary_display(selected_display, displays, display_count, &screen, status, sizeof(status));
 
                         // Reparse and rebuild menus with the new/updated data
-                        cleanup_display_data(displays, display_count, menu_items, connected_displays);
                         free(position_target_displays);
-                        if (!setup_display_data(&displays, &display_count, &menu_items, &num_items, &connected_displays, &connected_count)) {
+                        position_target_displays = NULL;
+                        if (ran && !reload_display_data(&displays, &display_count, &screen, &menu_items, &num_items, &connected_displays, &connected_count, &profiles, status, sizeof(status))) {
                             cleanup_ncurses();
                             fprintf(stderr, "Failed to re-parse xrandr data after setting primary.\n");
                             return 1;
@@ -537,6 +1595,146 @@ int main() {
                 }
                 break;
 
+            case 't':
+            case 'T':
+            case 'f':
+            case 'F':
+                if (state == STATE_MONITOR_SELECT && monitor_highlight < connected_count) {
+                    const Display *d = connected_displays[monitor_highlight];
+                    OutputChange *c = (OutputChange *)find_pending_change(&pending_changes, d->name);
+                    if (c == NULL) c = transaction_output(&pending_changes, d->name);
+                    if (c == NULL) break;
+                    if (!c->set_rotation) c->rotation = d->rotation;
+                    c->set_rotation = 1;
+                    c->rotation = (ch == 't' || ch == 'T') ? next_rotation(d, c->rotation) : next_reflection(d, c->rotation);
+                    snprintf(status, sizeof(status), "%s: rotate %s, reflect %s, press 'a' to apply", d->name,
+                             rotation_name(c->rotation), reflection_name(c->rotation));
+                    needs_redraw = true;
+                }
+                break;
+
+            case '+':
+            case '=':
+            case '-':
+                if (state == STATE_MONITOR_SELECT && monitor_highlight < connected_count && connected_displays[monitor_highlight]->is_active) {
+                    const Display *d = connected_displays[monitor_highlight];
+                    OutputChange *c = (OutputChange *)find_pending_change(&pending_changes, d->name);
+                    if (c == NULL) c = transaction_output(&pending_changes, d->name);
+                    if (c == NULL) break;
+                    double scale = (c->scale > 0.0 ? c->scale : d->scale) + (ch == '-' ? -0.25 : 0.25);
+                    c->scale = scale < 0.25 ? 0.25 : scale > 4.0 ? 4.0 : scale;
+                    snprintf(status, sizeof(status), "%s: scale %.2f, press 'a' to apply", d->name, c->scale);
+                    needs_redraw = true;
+                }
+                break;
+
+            case 'n':
+            case 'N':
+                if (state == STATE_MONITOR_SELECT) {
+                    // Scales and the positions that keep everything side by side go out together
+                    Transaction t;
+                    transaction_init(&t);
+                    displays_ensure_modes(displays, display_count);
+                    bool ran = false;
+                    if (layout_normalize_dpi(displays, display_count, &t, status, sizeof(status))) {
+                        if (t.output_count == 0) {
+                            snprintf(status, sizeof(status), "Every output already has about the same DPI");
+                        } else {
+                            ran = run_transaction(&t, displays, display_count, &screen, status, sizeof(status));
+                        }
+                    }
+                    transaction_free(&t);
+
+                    free(position_target_displays);
+                    position_target_displays = NULL;
+                    if (ran && !reload_display_data(&displays, &display_count, &screen, &menu_items, &num_items, &connected_displays, &connected_count, &profiles, status, sizeof(status))) {
+                        cleanup_ncurses();
+                        fprintf(stderr, "Failed to re-parse xrandr data after scaling.\n");
+                        return 1;
+                    }
+                    if (ran) {
+                        monitor_highlight = 0; monitor_scroll = 0;
+                    }
+                    needs_redraw = true;
+                }
+                break;
+
+            case 'a':
+            case 'A':
+                if (state == STATE_MONITOR_SELECT && (pending_layout.count > 0 || pending_changes.output_count > 0)) {
+                    bool ran = apply_layout(&pending_layout, &pending_changes, displays, display_count, &screen, status, sizeof(status));
+                    // A layout that was turned down stays, so it can be fixed up
+                    if (ran) {
+                        layout_free(&pending_layout);
+                        transaction_free(&pending_changes);
+                        transaction_init(&pending_changes);
+                    }
+
+                    free(position_target_displays);
+                    position_target_displays = NULL;
+                    if (ran && !reload_display_data(&displays, &display_count, &screen, &menu_items, &num_items, &connected_displays, &connected_count, &profiles, status, sizeof(status))) {
+                        cleanup_ncurses();
+                        fprintf(stderr, "Failed to re-parse xrandr data after applying the layout.\n");
+                        return 1;
+                    }
+
+                    state = STATE_MONITOR_SELECT;
+                    monitor_highlight = 0; monitor_scroll = 0;
+                    mode_highlight = 0; mode_scroll = 0;
+                    rate_highlight = 0; rate_scroll = 0;
+                    needs_redraw = true;
+                }
+                break;
+
+            case 'w':
+            case 'W':
+                if (state == STATE_MONITOR_SELECT) {
+                    bool ran = wire_default_provider(displays, display_count, &screen, status, sizeof(status));
+
+                    free(position_target_displays);
+                    position_target_displays = NULL;
+                    if (ran && !reload_display_data(&displays, &display_count, &screen, &menu_items, &num_items, &connected_displays, &connected_count, &profiles, status, sizeof(status))) {
+                        cleanup_ncurses();
+                        fprintf(stderr, "Failed to re-parse xrandr data after wiring providers.\n");
+                        return 1;
+                    }
+
+                    state = STATE_MONITOR_SELECT;
+                    monitor_highlight = 0; monitor_scroll = 0;
+                    needs_redraw = true;
+                }
+                break;
+
+            case 's':
+            case 'S':
+                if (state == STATE_MONITOR_SELECT) {
+                    save_current_profile(&profiles, displays, display_count, status, sizeof(status));
+                    needs_redraw = true;
+                }
+                break;
+
+            case 'r':
+            case 'R':
+                if (state == STATE_MONITOR_SELECT) {
+                    uint64_t selected_identity = 0;
+                    char selected_name[32] = "";
+                    if (monitor_highlight < connected_count) {
+                        selected_identity = display_identity(connected_displays[monitor_highlight]);
+                        snprintf(selected_name, sizeof(selected_name), "%s", connected_displays[monitor_highlight]->name);
+                    }
+                    // Pick up hotplugs; this also auto-applies a saved profile for a new monitor set.
+                    if (!reload_display_data(&displays, &display_count, &screen, &menu_items, &num_items, &connected_displays, &connected_count, &profiles, status, sizeof(status))) {
+                        cleanup_ncurses();
+                        profile_store_free(&profiles);
+                        fprintf(stderr, "Failed to re-parse xrandr data after refresh.\n");
+                        return 1;
+                    }
+                    monitor_highlight = find_monitor_row(connected_displays, connected_count, selected_identity, selected_name);
+                    monitor_scroll = 0;
+                    needs_redraw = true;
+                }
+                break;
+
             case KEY_RESIZE:
                 needs_redraw = true;
                 break;
@@ -548,7 +1746,7 @@ int main() {
                     int right_panel_view_height = rows - 8; // Approximate height for right-side lists
                     if (right_panel_view_height < 1) right_panel_view_height = 1;
 
-                    if (state == STATE_MONITOR_SELECT) {
+                    if (state == STATE_MONITOR_SELECT || state == STATE_VIDEO_WALL) {
                         monitor_highlight = (monitor_highlight == 0) ? num_items - 1 : monitor_highlight - 1;
                         if (monitor_highlight < monitor_scroll) {
                             monitor_scroll = monitor_highlight;
@@ -598,7 +1796,7 @@ int main() {
                     int right_panel_view_height = rows - 8; // Approximate height for right-side lists
                     if (right_panel_view_height < 1) right_panel_view_height = 1;
 
-                    if (state == STATE_MONITOR_SELECT) {
+                    if (state == STATE_MONITOR_SELECT || state == STATE_VIDEO_WALL) {
                         monitor_highlight = (monitor_highlight + 1) % num_items;
                         if (monitor_highlight >= monitor_scroll + monitor_view_height) {
                             monitor_scroll = monitor_highlight - monitor_view_height + 1;
@@ -650,7 +1848,8 @@ int main() {
 
             case KEY_RIGHT:
             case 'l':
-                if (state == STATE_MONITOR_SELECT && monitor_highlight < connected_count) {
+                if (state == STATE_MONITOR_SELECT && monitor_highlight < connected_count &&
+                    display_ensure_modes(connected_displays[monitor_highlight])) {
                     state = STATE_MODE_SELECT;
                     mode_highlight = 0; mode_scroll = 0;
                     rate_highlight = 0; rate_scroll = 0;
@@ -687,6 +1886,8 @@ int main() {
             case 10: // Enter key
                 if (state == STATE_MONITOR_SELECT) {
                     if (monitor_highlight == connected_count) goto end_loop; // "Exit" selected
+                    // Mode lists are only decoded for the outputs someone actually opens
+                    if (!display_ensure_modes(connected_displays[monitor_highlight])) break;
                     state = STATE_MODE_SELECT;
                     mode_highlight = 0; mode_scroll = 0;
                     rate_highlight = 0; rate_scroll = 0;
@@ -696,27 +1897,19 @@ int main() {
                     rate_highlight = 0; rate_scroll = 0;
                     needs_redraw = true;
                 } else if (state == STATE_POSITION_SELECT) {
-                    // Get selected items
+                    // Nothing moves yet: the placement joins the layout, which 'a' applies in one go
                     Display* source_display = connected_displays[monitor_highlight];
                     Display* target_display = position_target_displays[pos_target_highlight];
                     const char* direction = position_directions[pos_direction_highlight];
+                    if (layout_set(&pending_layout, source_display->name, direction, target_display->name)) {
+                        snprintf(status, sizeof(status), "%s %s %s, press 'a' to apply (%d placed)",
+                                 source_display->name, direction, target_display->name, pending_layout.count);
+                    }
 
-                    apply_position_settings(source_display, target_display, direction);
-
-                    cleanup_display_data(displays, display_count, menu_items, connected_displays);
                     free(position_target_displays);
                     position_target_displays = NULL;
-
-                    if (!setup_display_data(&displays, &display_count, &menu_items, &num_items, &connected_displays, &connected_count)) {
-                        cleanup_ncurses();
-                        fprintf(stderr, "Failed to re-parse xrandr data after position change.\n");
-                        return 1;
-                    }
-
+                    position_target_count = 0;
                     state = STATE_MONITOR_SELECT;
-                    monitor_highlight = 0; monitor_scroll = 0;
-                    mode_highlight = 0; mode_scroll = 0;
-                    rate_highlight = 0; rate_scroll = 0;
                     needs_redraw = true;
                 } else if (state == STATE_RATE_SELECT) {
                     // Get selected items
@@ -725,15 +1918,13 @@ int main() {
                     RefreshRate* selected_rate = &selected_mode->refresh_rates[rate_highlight];
 
                     // Apply settings
-                    apply_xrandr_settings(selected_display, selected_mode, selected_rate);
+                    bool ran = apply_xrandr_settings(selected_display, selected_mode, selected_rate,
+                                                     displays, display_count, &screen, status, sizeof(status));
 
-                    // Clean up old data structures
-                    cleanup_display_data(displays, display_count, menu_items, connected_displays);
+                    // Reparse and diff against the old data, which is freed afterwards
                     free(position_target_displays);
                     position_target_displays = NULL;
-
-                    // Reparse and rebuild menus with the new/updated data
-                    if (!setup_display_data(&displays, &display_count, &menu_items, &num_items, &connected_displays, &connected_count)) {
+                    if (ran && !reload_display_data(&displays, &display_count, &screen, &menu_items, &num_items, &connected_displays, &connected_count, &profiles, status, sizeof(status))) {
                         cleanup_ncurses();
                         fprintf(stderr, "Failed to re-parse xrandr data after mode change.\n");
                         return 1;
@@ -756,7 +1947,18 @@ end_loop:
 
     cleanup_display_data(displays, display_count, menu_items, connected_displays);
     free(position_target_displays);
+    layout_free(&pending_layout);
+    transaction_free(&pending_changes);
+    layout_map_free(&layout_map);
+    free(wall_outputs);
+    free(monitors_before);
+    free(monitors_after);
+    profile_store_free(&profiles);
     printf("myrandr exited cleanly.\n");
+    if (getenv("MYRANDR_TIMING") != NULL) {
+        printf("Time to first frame: %.2f ms (%s)\n", first_frame_ms,
+               from_cache ? "cached snapshot" : streaming ? "streamed query" : "live query");
+    }
 
     return 0;
 }
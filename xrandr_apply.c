@@ -0,0 +1,808 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "xrandr_apply.h"
+
+/**
+ * @brief Starts an empty transaction.
+ */
+void transaction_init(Transaction *t) {
+    t->outputs = NULL;
+    t->output_count = 0;
+    t->providers = NULL;
+    t->provider_count = 0;
+    t->monitors = NULL;
+    t->monitor_count = 0;
+    t->fb_width = 0;
+    t->fb_height = 0;
+}
+
+/**
+ * @brief Returns the change record for an output, adding a blank one if needed.
+ * @param t The transaction.
+ * @param name Output name (e.g. "HDMI-1").
+ * @return The change record, or NULL if memory ran out.
+ */
+OutputChange* transaction_output(Transaction *t, const char *name) {
+    for (int i = 0; i < t->output_count; i++) {
+        if (strcmp(t->outputs[i].name, name) == 0) {
+            return &t->outputs[i];
+        }
+    }
+
+    OutputChange *temp = realloc(t->outputs, (t->output_count + 1) * sizeof(OutputChange));
+    if (temp == NULL) {
+        perror("Failed to reallocate memory for output changes");
+        return NULL;
+    }
+    t->outputs = temp;
+
+    OutputChange *change = &t->outputs[t->output_count++];
+    memset(change, 0, sizeof(OutputChange));
+    snprintf(change->name, sizeof(change->name), "%s", name);
+    return change;
+}
+
+static int find_display(const Display *displays, int count, const char *name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(displays[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Adds provider wiring to the transaction. It goes out ahead of the outputs, but
+ * outputs that only show up once it's wired aren't known to that same xrandr call.
+ * @param provider XID of the provider to wire.
+ * @param offload 0 for an output source, 1 for an offload sink.
+ * @param peer XID of the output source or offload sink, 0 to unwire.
+ * @return False if memory ran out.
+ */
+bool transaction_provider(Transaction *t, unsigned long provider, int offload, unsigned long peer) {
+    ProviderChange *temp = realloc(t->providers, (t->provider_count + 1) * sizeof(ProviderChange));
+    if (temp == NULL) {
+        perror("Failed to reallocate memory for provider changes");
+        return false;
+    }
+    t->providers = temp;
+    t->providers[t->provider_count].provider = provider;
+    t->providers[t->provider_count].offload = offload;
+    t->providers[t->provider_count].peer = peer;
+    t->provider_count++;
+    return true;
+}
+
+/**
+ * @brief Returns the change record for a logical monitor, adding a blank one if needed.
+ * A blank one creates the monitor (or replaces the one with that name) once it's filled in.
+ * @param name Monitor name (e.g. "DP-2:1").
+ * @return The change record, or NULL if memory ran out.
+ */
+MonitorChange* transaction_monitor(Transaction *t, const char *name) {
+    for (int i = 0; i < t->monitor_count; i++) {
+        if (strcmp(t->monitors[i].name, name) == 0) return &t->monitors[i];
+    }
+
+    MonitorChange *temp = realloc(t->monitors, (t->monitor_count + 1) * sizeof(MonitorChange));
+    if (temp == NULL) {
+        perror("Failed to reallocate memory for monitor changes");
+        return NULL;
+    }
+    t->monitors = temp;
+
+    MonitorChange *change = &t->monitors[t->monitor_count++];
+    memset(change, 0, sizeof(MonitorChange));
+    snprintf(change->name, sizeof(change->name), "%s", name);
+    return change;
+}
+
+/**
+ * @brief Turns on (--auto) every connected output that's dark in the new snapshot and
+ * wasn't there in the old one, e.g. outputs of a provider that was just wired up.
+ * @return How many outputs were added, -1 if memory ran out.
+ */
+int transaction_light_new_outputs(Transaction *t, const Display *before, int before_count,
+                                  const Display *after, int after_count) {
+    int added = 0;
+    for (int i = 0; i < after_count; i++) {
+        const Display *d = &after[i];
+        if (!d->connected || d->is_active || find_display(before, before_count, d->name) >= 0) continue;
+        OutputChange *c = transaction_output(t, d->name);
+        if (c == NULL) return -1;
+        c->auto_mode = 1;
+        added++;
+    }
+    return added;
+}
+
+/**
+ * @brief Decodes the mode lists the transaction needs sizes from, and only those: outputs it
+ * names a mode for, and dark outputs it lights with --auto (their preferred mode).
+ * @return False if memory ran out.
+ */
+bool transaction_ensure_modes(const Transaction *t, Display *displays, int count) {
+    for (int i = 0; i < t->output_count; i++) {
+        const OutputChange *c = &t->outputs[i];
+        int index = find_display(displays, count, c->name);
+        if (index < 0) continue;
+        bool needs = c->mode[0] != '\0' || c->mode_id != 0 || (c->auto_mode && !displays[index].is_active);
+        if (needs && !display_ensure_modes(&displays[index])) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Points a change at one mode and rate. With verbose output every rate is its own
+ * modeline with an XID, which we pass straight on; otherwise xrandr gets size and rate.
+ */
+void output_change_set_mode(OutputChange *c, const Mode *mode, const RefreshRate *rate) {
+    // The exact name keeps "1920x1080i" and custom modes apart from the plain WxH one
+    if (mode->name[0] != '\0') {
+        snprintf(c->mode, sizeof(c->mode), "%s", mode->name);
+    } else {
+        snprintf(c->mode, sizeof(c->mode), "%dx%d", mode->width, mode->height);
+    }
+    c->rate = rate ? rate->rate : 0.0;
+    c->mode_id = (rate && rate->has_timing) ? rate->timing.id : 0;
+}
+
+/**
+ * @brief Small growable string for building command lines.
+ */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+} StrBuf;
+
+static int strbuf_append(StrBuf *sb, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int needed = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (needed < 0) return -1;
+
+    if (sb->len + needed + 1 > sb->capacity) {
+        size_t new_capacity = sb->capacity ? sb->capacity : 128;
+        while (new_capacity < sb->len + needed + 1) new_capacity *= 2;
+        char *temp = realloc(sb->data, new_capacity);
+        if (temp == NULL) return -1;
+        sb->data = temp;
+        sb->capacity = new_capacity;
+    }
+
+    va_start(args, fmt);
+    vsnprintf(sb->data + sb->len, sb->capacity - sb->len, fmt, args);
+    va_end(args);
+    sb->len += needed;
+    return 0;
+}
+
+/**
+ * @brief True if a change record asks for nothing at all.
+ */
+static bool output_change_is_empty(const OutputChange *c) {
+    return !c->off && !c->auto_mode && c->mode[0] == '\0' && c->mode_id == 0 && c->rate <= 0.0 &&
+           c->scale <= 0.0 && !c->set_rotation && !c->set_position && c->relation[0] == '\0' && !c->set_crtc &&
+           c->scale_from_width <= 0 && !c->set_panning && !c->primary;
+}
+
+/**
+ * @brief True if running the transaction wouldn't change anything.
+ */
+bool transaction_is_empty(const Transaction *t) {
+    for (int i = 0; i < t->output_count; i++) {
+        if (!output_change_is_empty(&t->outputs[i])) return false;
+    }
+    return t->provider_count == 0 && t->monitor_count == 0;
+}
+
+/**
+ * @brief Builds the single xrandr command line for the whole transaction.
+ * @return A malloc'd string (free it), or NULL if there is nothing to do or memory ran out.
+ */
+char* transaction_command(const Transaction *t) {
+    if (transaction_is_empty(t)) return NULL;
+
+    StrBuf sb = {NULL, 0, 0};
+    int err = strbuf_append(&sb, "xrandr");
+    if (t->fb_width > 0) {
+        err |= strbuf_append(&sb, " --fb %dx%d", t->fb_width, t->fb_height);
+    }
+
+    for (int i = 0; i < t->provider_count && !err; i++) {
+        const ProviderChange *p = &t->providers[i];
+        err |= strbuf_append(&sb, " --setprovider%s 0x%lx 0x%lx", p->offload ? "offloadsink" : "outputsource",
+                             p->provider, p->peer);
+    }
+
+    for (int i = 0; i < t->output_count && !err; i++) {
+        const OutputChange *c = &t->outputs[i];
+        if (output_change_is_empty(c)) continue; // e.g. an output only named to split it
+        err |= strbuf_append(&sb, " --output %s", c->name);
+
+        if (c->off) {
+            err |= strbuf_append(&sb, " --off");
+            continue; // Nothing else makes sense for an output that's going dark
+        }
+        if (c->mode_id != 0) {
+            // The XID names exactly one modeline, so there's no rate for xrandr to match up
+            err |= strbuf_append(&sb, " --mode 0x%lx", c->mode_id);
+        } else if (c->mode[0] != '\0') {
+            err |= strbuf_append(&sb, " --mode %s", c->mode);
+        } else if (c->auto_mode) {
+            err |= strbuf_append(&sb, " --auto");
+        }
+        if (c->rate > 0.0 && c->mode_id == 0) {
+            err |= strbuf_append(&sb, " --rate %.2f", c->rate);
+        }
+        if (c->set_rotation) {
+            err |= strbuf_append(&sb, " --rotate %s --reflect %s", rotation_name(c->rotation), reflection_name(c->rotation));
+        }
+        if (c->scale > 0.0) {
+            double m[9];
+            transform_for_scale(c->scale, m);
+            err |= strbuf_append(&sb, " --transform %g,%g,%g,%g,%g,%g,%g,%g,%g --filter %s",
+                                 m[0], m[1], m[2], m[3], m[4], m[5], m[6], m[7], m[8], filter_for_scale(c->scale));
+        }
+        if (c->set_panning) {
+            err |= strbuf_append(&sb, " --panning %dx%d", c->panning_width, c->panning_height);
+            if (c->panning_width > 0) err |= strbuf_append(&sb, "+%d+%d", c->panning_x, c->panning_y);
+        }
+        if (c->set_crtc) {
+            err |= strbuf_append(&sb, " --crtc %d", c->crtc);
+        }
+        if (c->scale_from_width > 0) {
+            err |= strbuf_append(&sb, " --scale-from %dx%d", c->scale_from_width, c->scale_from_height);
+        }
+        if (c->set_position) {
+            err |= strbuf_append(&sb, " --pos %dx%d", c->x_offset, c->y_offset);
+        } else if (c->relation[0] != '\0') {
+            err |= strbuf_append(&sb, " --%s %s", c->relation, c->relative_to);
+        }
+        if (c->primary) {
+            err |= strbuf_append(&sb, " --primary");
+        }
+    }
+
+    // Deleting first frees the outputs a monitor had, for the ones created after it
+    for (int i = 0; i < t->monitor_count && !err; i++) {
+        if (t->monitors[i].remove) err |= strbuf_append(&sb, " --delmonitor %s", t->monitors[i].name);
+    }
+    for (int i = 0; i < t->monitor_count && !err; i++) {
+        const MonitorChange *m = &t->monitors[i];
+        if (m->remove) continue;
+        err |= strbuf_append(&sb, " --setmonitor %s %d/%dx%d/%d+%d+%d %s", m->name, m->width, m->width_mm,
+                             m->height, m->height_mm, m->x_offset, m->y_offset, m->outputs[0] ? m->outputs : "none");
+    }
+
+    if (err) {
+        free(sb.data);
+        return NULL;
+    }
+    return sb.data;
+}
+
+/**
+ * @brief Size of the mode a change asks for: looked up by XID or name in the output's
+ * mode list, or read off a "WxH" name if the list isn't decoded.
+ * @return False if it can't be told.
+ */
+static bool change_mode_size(const Display *d, const OutputChange *c, int *width, int *height) {
+    for (int i = 0; i < d->mode_count; i++) {
+        const Mode *m = &d->modes[i];
+        bool found = c->mode_id == 0 && strcmp(m->name, c->mode) == 0;
+        for (int j = 0; j < m->rate_count && !found && c->mode_id != 0; j++) {
+            found = m->refresh_rates[j].timing.id == c->mode_id;
+        }
+        if (found && m->width > 0) {
+            *width = m->width;
+            *height = m->height;
+            return true;
+        }
+    }
+    return sscanf(c->mode, "%dx%d", width, height) == 2;
+}
+
+/**
+ * @brief Size of the mode --auto picks, i.e. the preferred one (else the first).
+ */
+static bool preferred_mode_size(const Display *d, int *width, int *height) {
+    const Mode *pick = d->mode_count > 0 ? &d->modes[0] : NULL;
+    for (int i = 0; i < d->mode_count; i++) {
+        for (int j = 0; j < d->modes[i].rate_count; j++) {
+            if (d->modes[i].refresh_rates[j].is_preferred) {
+                pick = &d->modes[i];
+                i = d->mode_count; // Done
+                break;
+            }
+        }
+    }
+    if (pick == NULL || pick->width == 0) return false;
+    *width = pick->width;
+    *height = pick->height;
+    return true;
+}
+
+/**
+ * @brief Multiplies a size by a scale factor. Partial pixels round up, as xrandr does it
+ * when it works out the area a transformed output covers.
+ */
+static void scale_size(int *width, int *height, double factor) {
+    double w = *width * factor, h = *height * factor;
+    *width = (int)w;
+    *height = (int)h;
+    if (*width < w - 1e-6) (*width)++;
+    if (*height < h - 1e-6) (*height)++;
+}
+
+/**
+ * @brief The transform that makes an output show scale times as many screen pixels in each
+ * direction as its mode has: the same matrix xrandr --scale builds.
+ * @param matrix Filled row by row.
+ */
+void transform_for_scale(double scale, double matrix[9]) {
+    for (int i = 0; i < 9; i++) matrix[i] = 0.0;
+    matrix[0] = scale;
+    matrix[4] = scale;
+    matrix[8] = 1.0;
+}
+
+/**
+ * @brief The filter a scale looks best with. Blowing every screen pixel up into a whole
+ * number of mode pixels (or not scaling at all) stays sharp with nearest; anything else
+ * needs bilinear to not look jagged.
+ */
+const char* filter_for_scale(double scale) {
+    double zoom = 1.0 / scale;
+    return zoom >= 1.0 && zoom - (int)(zoom + 0.5) < 1e-6 && zoom - (int)(zoom + 0.5) > -1e-6 ? "nearest" : "bilinear";
+}
+
+/**
+ * @brief Works out the layout a transaction would leave behind, without running anything.
+ * Relative placements are resolved against the target's planned geometry, in the order
+ * the changes were made.
+ * @param t The transaction.
+ * @param displays The current snapshot (decode the modes first for custom mode names).
+ * @param count The number of displays.
+ * @param planned Filled with one entry per display.
+ */
+void transaction_plan(const Transaction *t, const Display *displays, int count, PlannedOutput *planned) {
+    // A panning output takes up its whole panning area; the header only has the part on view
+    int panning_width[count > 0 ? count : 1];
+    int panning_height[count > 0 ? count : 1];
+    for (int i = 0; i < count; i++) {
+        const Display *d = &displays[i];
+        bool pans = d->panning_width > 0;
+        planned[i].lit = d->connected && d->is_active;
+        planned[i].x_offset = pans ? d->panning_x : d->x_offset;
+        planned[i].y_offset = pans ? d->panning_y : d->y_offset;
+        planned[i].width = planned[i].lit ? d->width : 0;
+        planned[i].height = planned[i].lit ? d->height : 0;
+        panning_width[i] = d->panning_width;
+        panning_height[i] = d->panning_height;
+    }
+
+    for (int i = 0; i < t->output_count; i++) {
+        const OutputChange *c = &t->outputs[i];
+        int index = find_display(displays, count, c->name);
+        if (index < 0) continue;
+        const Display *d = &displays[index];
+        PlannedOutput *p = &planned[index];
+
+        if (c->off) {
+            p->lit = 0;
+            continue;
+        }
+        // Mode sizes are unrotated and unscaled, the current size already has both applied
+        bool from_mode = false;
+        if (c->mode[0] != '\0' || c->mode_id != 0) {
+            if (!change_mode_size(d, c, &p->width, &p->height)) p->width = p->height = 0;
+            from_mode = true;
+            p->lit = 1;
+        } else if (c->auto_mode) {
+            // --auto keeps a lit output as it is and lights a dark one with its preferred mode
+            if (!p->lit && !preferred_mode_size(d, &p->width, &p->height)) p->width = p->height = 0;
+            from_mode = !p->lit;
+            p->lit = 1;
+        }
+        bool sideways = rotation_is_sideways(c->set_rotation ? c->rotation : d->rotation);
+        double current_scale = d->scale > 0.0 ? d->scale : 1.0;
+        double scale = c->scale > 0.0 ? c->scale : current_scale;
+        if (!from_mode && scale != current_scale) scale_size(&p->width, &p->height, 1.0 / current_scale);
+        if (from_mode ? sideways : sideways != rotation_is_sideways(d->rotation)) {
+            int width = p->width;
+            p->width = p->height;
+            p->height = width;
+        }
+        if (from_mode || scale != current_scale) scale_size(&p->width, &p->height, scale);
+        if (c->scale_from_width > 0 && p->lit) {
+            // The output is scaled to show this much of the screen
+            p->width = c->scale_from_width;
+            p->height = c->scale_from_height;
+        }
+        if (c->set_position) {
+            p->x_offset = c->x_offset;
+            p->y_offset = c->y_offset;
+        }
+        if (c->set_panning) {
+            panning_width[index] = c->panning_width;
+            panning_height[index] = c->panning_height;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        planned[i].view_width = planned[i].width;
+        planned[i].view_height = planned[i].height;
+        if (planned[i].lit && panning_width[i] > planned[i].width) planned[i].width = panning_width[i];
+        if (planned[i].lit && panning_height[i] > planned[i].height) planned[i].height = panning_height[i];
+    }
+
+    for (int i = 0; i < t->output_count; i++) {
+        const OutputChange *c = &t->outputs[i];
+        int index = find_display(displays, count, c->name);
+        int target = find_display(displays, count, c->relative_to);
+        if (c->relation[0] == '\0' || index < 0 || target < 0) continue;
+        PlannedOutput *p = &planned[index];
+        const PlannedOutput *to = &planned[target];
+
+        p->x_offset = to->x_offset;
+        p->y_offset = to->y_offset;
+        if (strcmp(c->relation, "right-of") == 0) p->x_offset += to->width;
+        else if (strcmp(c->relation, "left-of") == 0) p->x_offset -= p->width;
+        else if (strcmp(c->relation, "below") == 0) p->y_offset += to->height;
+        else if (strcmp(c->relation, "above") == 0) p->y_offset -= p->height;
+    }
+}
+
+/**
+ * @brief Tries to give an output a CRTC, moving other outputs along to CRTCs they can
+ * also use if that frees one up (an augmenting path, as in bipartite matching).
+ * A free CRTC is always taken first, so nothing moves that doesn't have to.
+ * @param visited CRTCs already looked at in this search.
+ */
+static bool claim_crtc(int output, const Display *displays, int *owner, int *assignment, uint32_t *visited) {
+    uint32_t candidates = displays[output].possible_crtcs & ~*visited;
+    for (int crtc = 0; crtc < 32; crtc++) {
+        if ((candidates & ((uint32_t)1 << crtc)) && owner[crtc] < 0) {
+            *visited |= (uint32_t)1 << crtc;
+            owner[crtc] = output;
+            assignment[output] = crtc;
+            return true;
+        }
+    }
+    for (int crtc = 0; crtc < 32; crtc++) {
+        if (!(candidates & ((uint32_t)1 << crtc)) || (*visited & ((uint32_t)1 << crtc))) continue;
+        *visited |= (uint32_t)1 << crtc;
+        if (claim_crtc(owner[crtc], displays, owner, assignment, visited)) {
+            owner[crtc] = output;
+            assignment[output] = crtc;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Whether every output the plan lights came with its CRTC list. Without the verbose
+ * CRTC lists there's nothing to plan with.
+ */
+static bool have_crtc_lists(const PlannedOutput *planned, const Display *displays, int count) {
+    for (int i = 0; i < count; i++) {
+        if (planned[i].lit && displays[i].possible_crtcs == 0) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Finds a CRTC for every output the plan lights, keeping outputs on the CRTC they
+ * already have wherever possible.
+ * @param assignment Filled with a CRTC per display, -1 for dark ones.
+ * @param err If no assignment exists, filled with the outputs that can't be on together.
+ * @return False if there's no assignment. Outputs without a CRTC list always pass.
+ */
+static bool assign_crtcs(const PlannedOutput *planned, const Display *displays, int count,
+                         int *assignment, char *err, size_t err_size) {
+    int owner[32];
+    for (int crtc = 0; crtc < 32; crtc++) owner[crtc] = -1;
+    for (int i = 0; i < count; i++) assignment[i] = -1;
+    if (!have_crtc_lists(planned, displays, count)) return true;
+
+    // Outputs that stay lit start on their current CRTC, so a working setup isn't shuffled
+    for (int i = 0; i < count; i++) {
+        int crtc = displays[i].crtc;
+        if (!planned[i].lit || crtc < 0 || crtc >= 32 || owner[crtc] >= 0) continue;
+        if (!(displays[i].possible_crtcs & ((uint32_t)1 << crtc))) continue;
+        owner[crtc] = i;
+        assignment[i] = crtc;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (!planned[i].lit || assignment[i] >= 0) continue;
+        uint32_t visited = 0;
+        if (claim_crtc(i, displays, owner, assignment, &visited)) continue;
+
+        // The search reached every CRTC this output could end up with; the outputs holding
+        // them plus this one are more outputs than those CRTCs, whatever we do.
+        int crtc_count = 0;
+        bool in_group[count];
+        memset(in_group, 0, sizeof(in_group));
+        in_group[i] = true;
+        for (int crtc = 0; crtc < 32; crtc++) {
+            if (!(visited & ((uint32_t)1 << crtc))) continue;
+            crtc_count++;
+            if (owner[crtc] >= 0) in_group[owner[crtc]] = true;
+        }
+
+        int member_count = 0;
+        for (int j = 0; j < count; j++) member_count += in_group[j];
+        size_t len = 0;
+        err[0] = '\0';
+        for (int j = 0, m = 0; j < count && len < err_size; j++) {
+            if (!in_group[j]) continue;
+            const char *sep = m == 0 ? "" : (m == member_count - 1 ? " and " : ", ");
+            len += snprintf(err + len, err_size - len, "%s%s", sep, displays[j].name);
+            m++;
+        }
+        if (len < err_size) {
+            snprintf(err + len, err_size - len, " can't %s be on: they share %d CRTC%s",
+                     member_count == 2 ? "both" : "all", crtc_count, crtc_count == 1 ? "" : "s");
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Bounding box of the lit outputs in a plan, see transaction_framebuffer().
+ */
+static bool planned_framebuffer(const PlannedOutput *planned, int count, int *width, int *height) {
+    int lit = 0;
+    bool sizes_known = true;
+    int min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+    for (int i = 0; i < count; i++) {
+        const PlannedOutput *p = &planned[i];
+        if (!p->lit) continue;
+        if (p->width <= 0 || p->height <= 0) sizes_known = false;
+        if (lit == 0 || p->x_offset < min_x) min_x = p->x_offset;
+        if (lit == 0 || p->y_offset < min_y) min_y = p->y_offset;
+        if (lit == 0 || p->x_offset + p->width > max_x) max_x = p->x_offset + p->width;
+        if (lit == 0 || p->y_offset + p->height > max_y) max_y = p->y_offset + p->height;
+        lit++;
+    }
+
+    // xrandr shifts everything right/down if something ends up left of or above the origin
+    *width = max_x - (min_x < 0 ? min_x : 0);
+    *height = max_y - (min_y < 0 ? min_y : 0);
+    return sizes_known && lit > 0;
+}
+
+/**
+ * @brief The screen (root framebuffer) size a transaction leaves behind: the bounding box
+ * of every lit output, scaled and rotated as planned. At 32 bits per pixel, it takes
+ * width * height * 4 bytes.
+ * @return False if nothing is lit or a size can't be told (then width/height are a guess).
+ */
+bool transaction_framebuffer(const Transaction *t, const Display *displays, int count, int *width, int *height) {
+    PlannedOutput planned[count > 0 ? count : 1];
+    transaction_plan(t, displays, count, planned);
+    return planned_framebuffer(planned, count, width, height);
+}
+
+/**
+ * @brief Size of the mode an output runs once the change has gone through, unrotated and unscaled.
+ * @return False if it can't be told.
+ */
+static bool planned_mode_size(const Display *d, const OutputChange *c, int *width, int *height) {
+    if (c && (c->mode[0] != '\0' || c->mode_id != 0)) return change_mode_size(d, c, width, height);
+    if (c && c->auto_mode && !d->is_active) return preferred_mode_size(d, width, height);
+    OutputChange current;
+    memset(&current, 0, sizeof(current));
+    snprintf(current.mode, sizeof(current.mode), "%s", d->mode_name);
+    return d->is_active && change_mode_size(d, &current, width, height);
+}
+
+/**
+ * @brief Makes every tiled monitor the transaction touches go as one (see display_tile_leader()).
+ * When the leader runs the tile mode, each other tile gets the same mode, rate and scale and sits
+ * next to it as the TILE property says; when it runs anything else (tiled monitors often have a
+ * smaller mode that one tile can show on its own) or goes dark, the other tiles go dark.
+ * Whatever was asked of the other tiles directly is replaced. Tiles aren't rotated.
+ * @return False if memory ran out.
+ */
+bool transaction_follow_tiles(Transaction *t, const Display *displays, int count) {
+    PlannedOutput planned[count > 0 ? count : 1];
+    transaction_plan(t, displays, count, planned);
+
+    for (int i = 0; i < count; i++) {
+        const Display *d = &displays[i];
+        const Display *leader = display_tile_leader(displays, count, d);
+        if (!d->connected || leader == d) continue;
+        int l = (int)(leader - displays);
+        int own = -1, lead = -1;
+        for (int j = 0; j < t->output_count; j++) {
+            if (strcmp(t->outputs[j].name, d->name) == 0) own = j;
+            if (strcmp(t->outputs[j].name, leader->name) == 0) lead = j;
+        }
+        if (own < 0 && lead < 0) continue;
+
+        // Copied, since adding the tile's change may move t->outputs
+        OutputChange from;
+        memset(&from, 0, sizeof(from));
+        if (lead >= 0) from = t->outputs[lead];
+        int width, height;
+        bool tiled = planned[l].lit && planned_mode_size(leader, lead >= 0 ? &from : NULL, &width, &height) &&
+                     width == leader->tile_width && height == leader->tile_height;
+
+        OutputChange *c = transaction_output(t, d->name);
+        if (c == NULL) return false;
+        memset(c, 0, sizeof(*c));
+        snprintf(c->name, sizeof(c->name), "%s", d->name);
+        if (!tiled) {
+            c->off = 1;
+            continue;
+        }
+        double rate = from.rate > 0.0 ? from.rate : leader->current_rate;
+        char name[32];
+        const Mode *m = NULL;
+        snprintf(name, sizeof(name), "%dx%d", d->tile_width, d->tile_height);
+        const RefreshRate *r = display_find_rate(d, name, rate, &m);
+        if (r) {
+            output_change_set_mode(c, m, r);
+        } else {
+            // The mode list isn't decoded, xrandr matches the name and rate up itself
+            snprintf(c->mode, sizeof(c->mode), "%s", name);
+            c->rate = rate;
+        }
+        c->scale = from.scale;
+        c->set_position = 1;
+        c->x_offset = planned[l].x_offset + d->tile_column * planned[l].width;
+        c->y_offset = planned[l].y_offset + d->tile_row * planned[l].height;
+    }
+    return true;
+}
+
+/**
+ * @brief True if the transaction moves or resizes an output, or turns one on or off. A new
+ * primary, rate or CRTC (or --off for an output that's dark anyway) leaves the screen as it is.
+ */
+static bool transaction_moves_outputs(const Transaction *t, const Display *displays, int count,
+                                      const PlannedOutput *planned) {
+    for (int i = 0; i < count; i++) {
+        if (planned[i].lit != (displays[i].connected && displays[i].is_active)) return true;
+    }
+    for (int i = 0; i < t->output_count; i++) {
+        const OutputChange *c = &t->outputs[i];
+        if (c->mode[0] != '\0' || c->mode_id != 0 || c->scale > 0.0 || c->set_rotation || c->set_position ||
+            c->relation[0] != '\0' || c->scale_from_width > 0 || c->set_panning) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Sizes the screen for what the transaction leaves behind, up front. Without --fb,
+ * changes applied one after another resize (and reallocate) the root framebuffer each time;
+ * with it, the screen goes straight to its final size in one go.
+ * Nothing is set if no output moves, resizes or goes on or off (a screen made bigger on
+ * purpose stays that way through a primary change), if the size can't be told, or if the
+ * screen already has it. Snapshots from the plain listing get no --fb either.
+ * Panning areas are anchored at their outputs' planned positions here too: given only a size,
+ * xrandr puts them at the top-left corner of the screen.
+ * @param screen The screen's limits and current size, NULL if unknown.
+ */
+void transaction_plan_screen(Transaction *t, const Display *displays, int count, const ScreenInfo *screen) {
+    PlannedOutput planned[count > 0 ? count : 1];
+    transaction_plan(t, displays, count, planned);
+    for (int i = 0; i < t->output_count; i++) {
+        OutputChange *c = &t->outputs[i];
+        int index = find_display(displays, count, c->name);
+        if (!c->set_panning || index < 0) continue;
+        c->panning_x = planned[index].x_offset;
+        c->panning_y = planned[index].y_offset;
+    }
+
+    int width, height;
+    t->fb_width = t->fb_height = 0;
+    // The plain listing (no CRTC lists) has no panning areas or transforms to plan with, and
+    // a plan without them could shrink the screen under an output
+    if (screen && screen->crtcs == 0) return;
+    if (!transaction_moves_outputs(t, displays, count, planned) || !planned_framebuffer(planned, count, &width, &height)) return;
+    if (screen) {
+        if (width < screen->min_width) width = screen->min_width;
+        if (height < screen->min_height) height = screen->min_height;
+        if (width == screen->width && height == screen->height) return;
+    }
+    t->fb_width = width;
+    t->fb_height = height;
+}
+
+/**
+ * @brief Checks a transaction against the screen's limits before anything is spawned:
+ * the planned bounding box has to fit the maximum framebuffer, every lit output
+ * needs a CRTC of its own, and monitors need their outputs lit. Limits that weren't
+ * reported aren't checked.
+ * @param screen The screen's limits, NULL to check only the CRTCs.
+ * @param err Filled with the reason if the layout is impossible.
+ * @return True if the layout looks possible.
+ */
+bool transaction_validate(const Transaction *t, const Display *displays, int count, const ScreenInfo *screen,
+                          char *err, size_t err_size) {
+    PlannedOutput planned[count > 0 ? count : 1];
+    transaction_plan(t, displays, count, planned);
+
+    int fb_width, fb_height;
+    if (screen && screen->max_width > 0 && planned_framebuffer(planned, count, &fb_width, &fb_height) &&
+        (fb_width > screen->max_width || fb_height > screen->max_height)) {
+        snprintf(err, err_size, "Layout needs a %dx%d screen, but the maximum is %dx%d",
+                 fb_width, fb_height, screen->max_width, screen->max_height);
+        return false;
+    }
+
+    // A monitor can only be made of outputs that end up lit
+    for (int i = 0; i < t->monitor_count; i++) {
+        const MonitorChange *m = &t->monitors[i];
+        char outputs[sizeof(m->outputs)];
+        if (m->remove) continue;
+        snprintf(outputs, sizeof(outputs), "%s", m->outputs);
+        for (char *name = strtok(outputs, ","); name; name = strtok(NULL, ",")) {
+            int index = find_display(displays, count, name);
+            if (index < 0 || !planned[index].lit) {
+                snprintf(err, err_size, "Monitor %s is on %s, which is %s", m->name, name, index < 0 ? "not there" : "off");
+                return false;
+            }
+        }
+    }
+
+    // Counting isn't enough: two outputs may only be able to use the same CRTC
+    int assignment[count > 0 ? count : 1];
+    return assign_crtcs(planned, displays, count, assignment, err, err_size);
+}
+
+/**
+ * @brief Pins every output the transaction lights to a CRTC from a feasible assignment,
+ * with --crtc where it differs from what the output has now. xrandr picks CRTCs greedily
+ * in output order and can paint itself into a corner the planner wouldn't.
+ * @return False if there's no assignment (see transaction_validate()) or memory ran out.
+ */
+bool transaction_assign_crtcs(Transaction *t, const Display *displays, int count) {
+    PlannedOutput planned[count > 0 ? count : 1];
+    int assignment[count > 0 ? count : 1];
+    char err[256];
+    transaction_plan(t, displays, count, planned);
+    // No CRTC data, no --crtc: leave the choice to xrandr
+    if (!have_crtc_lists(planned, displays, count)) return true;
+    if (!assign_crtcs(planned, displays, count, assignment, err, sizeof(err))) return false;
+
+    for (int i = 0; i < count; i++) {
+        if (assignment[i] < 0 || assignment[i] == displays[i].crtc) continue;
+        // An output that only moves CRTC gets a record of its own; xrandr keeps its mode
+        OutputChange *c = transaction_output(t, displays[i].name);
+        if (c == NULL) return false;
+        c->set_crtc = 1;
+        c->crtc = assignment[i];
+    }
+    return true;
+}
+
+/**
+ * @brief Runs the transaction as one xrandr call.
+ * @return The exit status of the command, or -1 if it could not be built.
+ */
+int transaction_apply(const Transaction *t) {
+    char *command = transaction_command(t);
+    if (command == NULL) return -1;
+
+    int status = system(command);
+    free(command);
+    return status;
+}
+
+/**
+ * @brief Frees the memory held by a transaction and leaves it empty.
+ */
+void transaction_free(Transaction *t) {
+    free(t->outputs);
+    free(t->providers);
+    free(t->monitors);
+    transaction_init(t);
+}
@@ -0,0 +1,107 @@
+#ifndef XRANDR_APPLY_H
+#define XRANDR_APPLY_H
+
+#include "xrandr_parser.h"
+
+/**
+ * @brief Everything we want to change on one output. Zero means "leave as is".
+ */
+typedef struct {
+    char name[32];
+    int off;              // --off
+    int auto_mode;        // --auto
+    char mode[32];        // --mode (e.g. "1920x1080")
+    unsigned long mode_id; // --mode by XID (e.g. 0x4d); wins over mode and rate
+    double rate;          // --rate
+    double scale;         // --transform scaling by this much (plus a --filter to suit), 0 to leave
+    int set_rotation;     // --rotate and --reflect
+    unsigned int rotation; // ROTATION_* | REFLECT_* bits
+    int set_position;     // --pos x_offset x y_offset
+    int x_offset;
+    int y_offset;
+    char relation[16];    // --right-of, --left-of, --above, --below, --same-as
+    char relative_to[32];
+    int set_crtc;         // --crtc crtc
+    int crtc;
+    int scale_from_width; // --scale-from, 0 if not set: the screen area the output shows
+    int scale_from_height;
+    int set_panning;      // --panning WxH+X+Y, 0x0 turns panning off
+    int panning_width;    // The area the output scrolls over; its origin is filled in by
+    int panning_height;   // transaction_plan_screen(), at the output's planned position
+    int panning_x;
+    int panning_y;
+    int primary;          // --primary
+} OutputChange;
+
+/**
+ * @brief Wiring between two providers (GPUs), set before any output is touched.
+ */
+typedef struct {
+    unsigned long provider; // XID of the provider being wired
+    int offload;            // --setprovideroffloadsink instead of --setprovideroutputsource
+    unsigned long peer;     // XID of the output source or offload sink, 0 unwires
+} ProviderChange;
+
+/**
+ * @brief A RandR 1.5 logical monitor to create, resize (same name again) or delete.
+ * They go out after the outputs, so they can use outputs the same call lights up.
+ */
+typedef struct {
+    char name[64];
+    int remove;           // --delmonitor
+    int width, height;    // --setmonitor WIDTH/WIDTH_MMxHEIGHT/HEIGHT_MM+X+Y OUTPUTS
+    int width_mm, height_mm;
+    int x_offset, y_offset;
+    char outputs[128];    // Comma separated, "" for none
+} MonitorChange;
+
+/**
+ * @brief A batch of output changes that goes out as a single xrandr call.
+ */
+typedef struct {
+    OutputChange *outputs;
+    int output_count;
+    ProviderChange *providers;
+    int provider_count;
+    MonitorChange *monitors;
+    int monitor_count;
+    int fb_width;  // --fb, so the screen is resized once to its final size; 0 to leave it to xrandr
+    int fb_height;
+} Transaction;
+
+/**
+ * @brief Where an output ends up once a transaction has gone through.
+ */
+typedef struct {
+    int lit;
+    int x_offset;
+    int y_offset;
+    int width;  // 0 if the size can't be told (e.g. an unknown custom mode)
+    int height;
+    int view_width;  // The part on view: the same as width/height unless the output pans
+    int view_height;
+} PlannedOutput;
+
+void transaction_init(Transaction *t);
+OutputChange* transaction_output(Transaction *t, const char *name);
+bool transaction_provider(Transaction *t, unsigned long provider, int offload, unsigned long peer);
+MonitorChange* transaction_monitor(Transaction *t, const char *name);
+int transaction_light_new_outputs(Transaction *t, const Display *before, int before_count,
+                                  const Display *after, int after_count);
+bool transaction_ensure_modes(const Transaction *t, Display *displays, int count);
+void output_change_set_mode(OutputChange *c, const Mode *mode, const RefreshRate *rate);
+bool transaction_is_empty(const Transaction *t);
+char* transaction_command(const Transaction *t);
+void transaction_plan(const Transaction *t, const Display *displays, int count, PlannedOutput *planned);
+void transform_for_scale(double scale, double matrix[9]);
+const char* filter_for_scale(double scale);
+bool transaction_framebuffer(const Transaction *t, const Display *displays, int count, int *width, int *height);
+bool transaction_follow_tiles(Transaction *t, const Display *displays, int count);
+void transaction_plan_screen(Transaction *t, const Display *displays, int count, const ScreenInfo *screen);
+bool transaction_validate(const Transaction *t, const Display *displays, int count, const ScreenInfo *screen,
+                          char *err, size_t err_size);
+bool transaction_assign_crtcs(Transaction *t, const Display *displays, int count);
+int transaction_apply(const Transaction *t);
+void transaction_free(Transaction *t);
+
+#endif // XRANDR_APPLY_H
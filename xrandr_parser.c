@@ -6,6 +6,8 @@
 #include <string.h>
 #include <ctype.h>
 #include "xrandr_parser.h"
+#include "hash.h"
+#include "edid.h"
 
 /**
  * @brief Prints the details of all parsed displays.
@@ -13,28 +15,78 @@
  * @param displays An array of Display structs.
  * @param count The number of displays in the array.
  */
-void print_displays(const Display *displays, int count) {
+void print_displays(Display *displays, int count) {
+    fprint_displays(stdout, displays, count);
+}
+
+/**
+ * @brief Same as print_displays(), but writes to any stream.
+ * Decodes the mode lists, since it prints them.
+ */
+void fprint_displays(FILE *out, Display *displays, int count) {
     for (int i = 0; i < count; i++) {
-        printf("\nDisplay #%d:\n", i + 1);
-        printf("  Name: %s\n", displays[i].name);
-        printf("  Connected: %s\n", displays[i].connected ? "Yes" : "No");
+        display_ensure_modes(&displays[i]);
+        fprintf(out, "\nDisplay #%d:\n", i + 1);
+        fprintf(out, "  Name: %s\n", displays[i].name);
+        fprintf(out, "  Connected: %s\n", displays[i].connected ? "Yes" : "No");
 
         if (displays[i].connected) {
-            printf("  Primary: %s\n", displays[i].is_primary ? "Yes" : "No");
+            fprintf(out, "  Primary: %s\n", displays[i].is_primary ? "Yes" : "No");
             if (displays[i].width > 0) {
-                 printf("  Current Resolution: %dx%d at +%d+%d\n", displays[i].width, displays[i].height, displays[i].x_offset, displays[i].y_offset);
+                 fprintf(out, "  Current Resolution: %dx%d at +%d+%d\n", displays[i].width, displays[i].height, displays[i].x_offset, displays[i].y_offset);
+            }
+            if (displays[i].width_mm > 0) {
+                fprintf(out, "  Physical Size: %dx%d mm", displays[i].width_mm, displays[i].height_mm);
+                if (display_dpi(&displays[i]) > 0.0) fprintf(out, ", %.0f DPI", display_dpi(&displays[i]));
+                fputc('\n', out);
+            }
+            if (displays[i].panning_width > 0) {
+                fprintf(out, "  Panning: %dx%d+%d+%d\n", displays[i].panning_width, displays[i].panning_height,
+                        displays[i].panning_x, displays[i].panning_y);
+            }
+            if (displays[i].tile_group != 0) {
+                fprintf(out, "  Tile: %d,%d of %dx%d in group %d (%dx%d each)\n", displays[i].tile_column,
+                        displays[i].tile_row, displays[i].tile_columns, displays[i].tile_rows,
+                        displays[i].tile_group, displays[i].tile_width, displays[i].tile_height);
+            }
+            if (displays[i].scale != 1.0 && displays[i].scale > 0.0) {
+                fprintf(out, "  Scale: %.3g\n", displays[i].scale);
+            }
+            if (displays[i].rotations != 0) {
+                fprintf(out, "  Rotation: %s, reflect %s (can do", rotation_name(displays[i].rotation),
+                        reflection_name(displays[i].rotation));
+                for (int r = 0; r < 4; r++) {
+                    if (displays[i].rotations & (ROTATION_NORMAL << r)) fprintf(out, " %s", rotation_name(ROTATION_NORMAL << r));
+                }
+                if (displays[i].rotations & REFLECT_MASK) {
+                    fprintf(out, ", reflect %s", reflection_name(displays[i].rotations));
+                }
+                fprintf(out, ")\n");
+            }
+            const EdidInfo *edid = display_edid(&displays[i]);
+            if (edid) {
+                fprintf(out, "  Monitor: %s (%s %04x, %dx%d mm)\n", edid->model[0] ? edid->model : "unnamed",
+                        edid->manufacturer, edid->product_code, edid->width_mm, edid->height_mm);
+            }
+            if (displays[i].possible_crtcs != 0) {
+                if (displays[i].crtc >= 0) fprintf(out, "  CRTC: %d (can use", displays[i].crtc);
+                else fprintf(out, "  CRTC: none (can use");
+                for (int c = 0; c < 32; c++) {
+                    if (displays[i].possible_crtcs & ((uint32_t)1 << c)) fprintf(out, " %d", c);
+                }
+                fprintf(out, ")\n");
             }
-            printf("  Available modes (%d):\n", displays[i].mode_count);
+            fprintf(out, "  Available modes (%d):\n", displays[i].mode_count);
             for (int j = 0; j < displays[i].mode_count; j++) {
                 Mode *mode = &displays[i].modes[j];
-                printf("    - %dx%d (Refresh rates:", mode->width, mode->height);
+                fprintf(out, "    - %s (Refresh rates:", mode->name);
                 for (int k = 0; k < mode->rate_count; k++) {
                     RefreshRate *rate = &mode->refresh_rates[k];
-                    printf(" %.2f", rate->rate);
-                    if (rate->is_current) printf("*");
-                    if (rate->is_preferred) printf("+");
+                    fprintf(out, " %.2f", rate->rate);
+                    if (rate->is_current) fputc('*', out);
+                    if (rate->is_preferred) fputc('+', out);
                 }
-                printf(")\n");
+                fprintf(out, ")\n");
             }
         }
     }
@@ -53,6 +105,10 @@ void free_displays(Display *displays, int count) {
             free(displays[i].modes[j].refresh_rates);
         }
         free(displays[i].modes);
+        free(displays[i].mode_text);
+        free(displays[i].edid);
+        free(displays[i].property_text);
+        free(displays[i].properties);
     }
     free(displays);
 }
@@ -60,150 +116,941 @@ void free_displays(Display *displays, int count) {
 /**
  * @brief Executes xrandr, parses its output, and returns structured display info.
  * @param display_count Pointer to an integer that will be filled with the number of displays found.
+ * @param screen If not NULL, filled with the screen's framebuffer limits.
+ * @param verbose Ask for --verbose (see XRANDR_VERBOSE_ARG).
  * @return A dynamically allocated array of Display structs. Don't forget to free this memory with free_displays().
  */
-Display* parse_xrandr_output(int *display_count) {
-    FILE *fp;
-    char line[256];
-    Display *displays = NULL;
+Display* parse_xrandr_output(int *display_count, ScreenInfo *screen, bool verbose) {
     *display_count = 0;
-    Display *current_display_ptr = NULL;
+    if (screen) memset(screen, 0, sizeof(ScreenInfo));
 
     // Run the xrandr command and open a pipe to read. Try and do both with popen()
-    fp = popen("xrandr", "r");
+    FILE *fp = popen(verbose ? "xrandr " XRANDR_VERBOSE_ARG : "xrandr", "r");
     if (fp == NULL) {
         perror("Failed to run xrandr command");
         return NULL;
     }
 
-    // Read the output line by line.
-    while (fgets(line, sizeof(line), fp) != NULL) {
-        // Check for lines that describe a display connection
-        if (strstr(line, " connected")) {
-            (*display_count)++;
-            Display *temp_displays = realloc(displays, (*display_count) * sizeof(Display));
-            if (temp_displays == NULL) {
-                perror("Failed to reallocate memory for displays");
-                free_displays(displays, (*display_count) - 1);
-                pclose(fp);
-                return NULL;
-            }
-            displays = temp_displays;
-            current_display_ptr = &displays[(*display_count) - 1];
-            memset(current_display_ptr, 0, sizeof(Display));
-
-            if (strstr(line, " connected")) {
-                current_display_ptr->connected = 1;
-                int matches = 0;
-                if (strstr(line, " primary")) {
-                    current_display_ptr->is_primary = 1;
-                    matches = sscanf(line, "%s connected primary %dx%d+%d+%d",
-                           current_display_ptr->name,
-                           &current_display_ptr->width, &current_display_ptr->height,
-                           &current_display_ptr->x_offset, &current_display_ptr->y_offset);
-                } else {
-                    current_display_ptr->is_primary = 0;
-                    matches = sscanf(line, "%s connected %dx%d+%d+%d",
-                           current_display_ptr->name,
-                           &current_display_ptr->width, &current_display_ptr->height,
-                           &current_display_ptr->x_offset, &current_display_ptr->y_offset);
-                }
-                if (matches == 5) { // 1 for name, 4 for geometry
-                    current_display_ptr->is_active = 1;
-                } else {
-                    current_display_ptr->is_active = 0;
-                    // If geometry parsing failed, at least get the name
-                    sscanf(line, "%s", current_display_ptr->name);
-                }
+    Display *displays = parse_xrandr_stream(fp, display_count, screen);
+    pclose(fp);
+    return displays;
+}
+
+/**
+ * @brief Runs xrandr and returns its whole output, for callers that want to keep the raw text.
+ * @param len Filled with the length of the text.
+ * @param verbose Ask for --verbose (see XRANDR_VERBOSE_ARG).
+ * @return A malloc'd, NUL-terminated buffer, or NULL on failure.
+ */
+char* read_xrandr_output(size_t *len, bool verbose) {
+    *len = 0;
+    FILE *fp = popen(verbose ? "xrandr " XRANDR_VERBOSE_ARG : "xrandr", "r");
+    if (fp == NULL) {
+        perror("Failed to run xrandr command");
+        return NULL;
+    }
+
+    size_t capacity = 4096;
+    char *text = malloc(capacity);
+    size_t n;
+    while (text && (n = fread(text + *len, 1, capacity - *len - 1, fp)) > 0) {
+        *len += n;
+        if (capacity - *len - 1 == 0) {
+            char *temp = realloc(text, capacity * 2);
+            if (temp == NULL) { free(text); text = NULL; break; }
+            text = temp;
+            capacity *= 2;
+        }
+    }
+
+    if (pclose(fp) != 0 || text == NULL) {
+        free(text);
+        return NULL;
+    }
+    text[*len] = '\0';
+    return text;
+}
+
+/**
+ * @brief Parses xrandr output that is already in memory (e.g. handed over by the daemon).
+ * @param text The output of xrandr.
+ * @param len Length of the text.
+ * @param display_count Filled with the number of displays found.
+ * @param screen If not NULL, filled with the screen's framebuffer limits.
+ * @return Same as parse_xrandr_output().
+ */
+Display* parse_xrandr_text(const char *text, size_t len, int *display_count, ScreenInfo *screen) {
+    *display_count = 0;
+    if (screen) memset(screen, 0, sizeof(ScreenInfo));
+    if (len == 0) return NULL;
+
+    XrandrParser parser;
+    xrandr_parser_init(&parser);
+    xrandr_parser_feed(&parser, text, len);
+    return xrandr_parser_finish(&parser, display_count, screen);
+}
+
+/**
+ * @brief Fills in size and flags from a mode's name, as far as the name tells.
+ * "1920x1080i" is interlaced; a custom name like "my-mode" says nothing.
+ */
+static void decode_mode_name(Mode *mode) {
+    int w, h, n = 0;
+    if (sscanf(mode->name, "%dx%d%n", &w, &h, &n) == 2) {
+        mode->width = w;
+        mode->height = h;
+        if (strcmp(&mode->name[n], "i") == 0) mode->interlaced = 1;
+    }
+}
+
+/**
+ * @brief Decodes one mode line into a Mode.
+ * @param line Pvz: "   1920x1080     60.01*+  59.97    59.96    59.93  "
+ * @param mode Filled in; free mode->refresh_rates when done.
+ * @return 1 if the line was a mode line, -1 if it was one whose name doesn't fit Mode.name
+ * (skip it: a cut name isn't one --mode knows), 0 otherwise.
+ */
+static int decode_mode_line(const char *line, Mode *mode) {
+    int n = 0;
+    memset(mode, 0, sizeof(Mode));
+    // The first word is the name; %n finds where the rates start. Sizes come out of the name
+    // afterwards, since "1920x1080i" or "my-mode" would trip up a plain " %dx%d".
+    if (sscanf(line, " %31s%n", mode->name, &n) != 1 || n == 0) {
+        return 0;
+    }
+    // Stopped at 31 characters rather than at the end of the word: the rest isn't rates
+    if (line[n] != '\0' && !isspace((unsigned char)line[n])) return -1;
+    decode_mode_name(mode);
+
+    const char *ptr = &line[n]; // Start parsing for refresh rates from here
+    char *endptr;
+
+    // Loop through the rest of the line to find all refresh rates
+    while (1) {
+        // strtod converts string to double, skipping leading whitespace,
+        // and updates endptr to point after the parsed number.
+        double rate_val = strtod(ptr, &endptr);
+
+        // If no conversion was made, we've reached the end of the numbers.
+        if (ptr == endptr) {
+            break;
+        }
+
+        // A new refresh rate was found, add it to the current mode
+        mode->rate_count++;
+        RefreshRate *temp_rates = realloc(mode->refresh_rates, mode->rate_count * sizeof(RefreshRate));
+        if (temp_rates == NULL) { /* Handle error later */ exit(1); }
+        mode->refresh_rates = temp_rates;
+
+        RefreshRate *current_rate = &mode->refresh_rates[mode->rate_count - 1];
+        memset(current_rate, 0, sizeof(RefreshRate));
+        current_rate->rate = rate_val;
+
+        ptr = endptr; // ptr now points to potential markers like '*' or '+'
+
+        // accounting for variable whitespace and handle the '+' '*' 
+        while (1) {
+            // Skip any whitespace between the number and a potential marker.
+            while (*ptr && isspace((unsigned char)*ptr)) {
+                ptr++;
+            }
+
+            if (*ptr == '*') {
+                current_rate->is_current = 1;
+                ptr++; // Consume the marker
+            } else if (*ptr == '+') {
+                current_rate->is_preferred = 1;
+                ptr++; // Consume the marker
+            } else {
+                // break the marker-parsing loop
+                break;
+            }
+        }
+    }
+    return mode->rate_count > 0;
+}
+
+/**
+ * @brief Decodes a verbose modeline header.
+ * @param line Pvz: "  1920x1080 (0x47) 138.700MHz +HSync -VSync *current +preferred"
+ * @param name Filled with the mode name ("1920x1080").
+ * @param rate Filled in; the h:/v: lines that follow complete it.
+ * @return 1 if the line was a verbose mode line, -1 if it was one whose name doesn't fit name
+ * (skip it and its h:/v: lines, like decode_mode_line() does), 0 otherwise.
+ */
+static int decode_verbose_mode_line(const char *line, char *name, size_t name_size, RefreshRate *rate) {
+    char mode_name[256];
+    int n = 0;
+    memset(rate, 0, sizeof(RefreshRate));
+    if (sscanf(line, " %255s (0x%lx) %lfMHz%n", mode_name, &rate->timing.id, &rate->timing.pixel_clock, &n) != 3 || n == 0) {
+        return 0;
+    }
+    if (strlen(mode_name) >= name_size) return -1;
+    snprintf(name, name_size, "%s", mode_name);
+    rate->has_timing = 1;
+
+    // Whatever follows is flags; *current and +preferred are ours, the rest belongs to the modeline
+    const char *ptr = line + n;
+    char flag[32];
+    int used;
+    size_t flags_len = 0;
+    while (sscanf(ptr, " %31s%n", flag, &used) == 1) {
+        ptr += used;
+        if (strcmp(flag, "*current") == 0) {
+            rate->is_current = 1;
+        } else if (strcmp(flag, "+preferred") == 0) {
+            rate->is_preferred = 1;
+        } else if (flags_len + strlen(flag) + 2 <= sizeof(rate->timing.flags)) {
+            flags_len += snprintf(rate->timing.flags + flags_len, sizeof(rate->timing.flags) - flags_len,
+                                  "%s%s", flags_len ? " " : "", flag);
+        }
+    }
+    return 1;
+}
+
+static uint64_t gcd_u64(uint64_t a, uint64_t b) {
+    while (b != 0) {
+        uint64_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+/**
+ * @brief Works out the exact refresh rate of a modeline: pixel clock / (htotal * vtotal),
+ * doubled for interlaced modes and halved for doublescan, like the X server does.
+ * @return True if the timing was complete enough.
+ */
+static bool compute_exact_rate(ModeTiming *t) {
+    if (t->pixel_clock <= 0.0 || t->h_total <= 0 || t->v_total <= 0) return false;
+
+    // xrandr prints the clock with kHz precision, which is how modelines specify it anyway
+    uint64_t num = (uint64_t)(t->pixel_clock * 1000.0 + 0.5) * 1000;
+    uint64_t den = (uint64_t)t->h_total * (uint64_t)t->v_total;
+    if (strstr(t->flags, "Interlace")) num *= 2;
+    if (strstr(t->flags, "DoubleScan")) den *= 2;
+
+    uint64_t g = gcd_u64(num, den);
+    t->rate_num = num / g;
+    t->rate_den = den / g;
+    return true;
+}
+
+/**
+ * @brief Decodes the "h:" or "v:" line below a verbose modeline into its timing.
+ * Once the "v:" line is in, the rate is the exact one rather than the rounded clock xrandr prints.
+ * @return 1 if the line was one of them, 0 otherwise.
+ */
+static int decode_timing_line(const char *line, RefreshRate *rate) {
+    ModeTiming *t = &rate->timing;
+    double clock;
+    if (sscanf(line, " h: width %d start %d end %d total %d skew %d",
+               &t->h_display, &t->h_sync_start, &t->h_sync_end, &t->h_total, &t->h_skew) == 5) {
+        return 1;
+    }
+    if (sscanf(line, " v: height %d start %d end %d total %d clock %lf",
+               &t->v_display, &t->v_sync_start, &t->v_sync_end, &t->v_total, &clock) == 5) {
+        rate->rate = compute_exact_rate(t) ? (double)t->rate_num / (double)t->rate_den : clock;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Appends a line to one of a display's raw text blocks.
+ * @return 1 on success, 0 if memory ran out.
+ */
+static int append_text(char **text, size_t *text_len, const char *line) {
+    size_t len = strlen(line);
+    char *temp = realloc(*text, *text_len + len + 1);
+    if (temp == NULL) {
+        perror("Failed to reallocate memory for xrandr output");
+        return 0;
+    }
+    *text = temp;
+    memcpy(*text + *text_len, line, len + 1);
+    *text_len += len;
+    return 1;
+}
+
+/**
+ * @brief Phase one of parsing: keeps a display's mode line as raw text.
+ * Only the current mode gets looked at now, for the current rate.
+ * @return 1 on success, 0 if memory ran out.
+ */
+static int append_mode_line(XrandrParser *parser, Display *d, const char *line) {
+    if (!append_text(&d->mode_text, &d->mode_text_len, line)) {
+        return 0;
+    }
+
+    // The '*' moves whenever the rate changes, so hash it as the blank xrandr prints otherwise.
+    // Verbose output spells it " *current", which is left out altogether.
+    size_t len = strlen(line);
+    for (size_t i = 0; i < len; i++) {
+        if (strncmp(&line[i], " *current", 9) == 0) {
+            i += 8;
+            continue;
+        }
+        char c = line[i] == '*' ? ' ' : line[i];
+        d->mode_signature = fnv1a_64(&c, 1, d->mode_signature);
+    }
+
+    RefreshRate rate;
+    char name[32];
+    int verbose = decode_verbose_mode_line(line, name, sizeof(name), &rate);
+    if (verbose > 0) {
+        parser->current_pending = rate.is_current;
+        parser->pending_rate = rate;
+        if (rate.is_current) snprintf(d->mode_name, sizeof(d->mode_name), "%s", name);
+    } else if (verbose < 0) {
+        parser->current_pending = false; // Its h:/v: lines aren't the current mode's
+    } else if (parser->current_pending && decode_timing_line(line, &parser->pending_rate)) {
+        // The refresh rate of a verbose modeline needs its "h:" and "v:" lines
+        if (parser->pending_rate.rate > 0.0) {
+            d->current_rate = parser->pending_rate.rate;
+            parser->current_pending = false;
+        }
+    } else if (strchr(line, '*')) {
+        Mode mode;
+        if (decode_mode_line(line, &mode) > 0) {
+            for (int i = 0; i < mode.rate_count; i++) {
+                if (!mode.refresh_rates[i].is_current) continue;
+                d->current_rate = mode.refresh_rates[i].rate;
+                snprintf(d->mode_name, sizeof(d->mode_name), "%s", mode.name);
+            }
+        }
+        free(mode.refresh_rates);
+    }
+    return 1;
+}
+
+/**
+ * @brief Checks for a line of EDID hex, e.g. "\t\t00ffffffffffff0010ac..."
+ */
+static bool is_edid_line(const char *line) {
+    if (line[0] != '\t' || line[1] != '\t') return false;
+    int digits = 0;
+    for (const char *p = line + 2; *p && *p != '\n'; p++, digits++) {
+        if (!isxdigit((unsigned char)*p)) return false;
+    }
+    return digits > 0 && digits % 2 == 0;
+}
+
+/**
+ * @brief Appends the bytes of one EDID hex line to the display's EDID.
+ * @return 1 on success, 0 if memory ran out.
+ */
+static int append_edid_line(Display *d, const char *line) {
+    const char *hex = line + 2;
+    size_t count = strcspn(hex, "\n") / 2;
+    unsigned char *temp = realloc(d->edid, d->edid_len + count);
+    if (temp == NULL) {
+        perror("Failed to reallocate memory for EDID");
+        return 0;
+    }
+    d->edid = temp;
+    for (size_t i = 0; i < count; i++) {
+        unsigned int byte;
+        sscanf(hex + 2 * i, "%2x", &byte);
+        d->edid[d->edid_len++] = (unsigned char)byte;
+    }
+    return 1;
+}
+
+static bool push_mode(Display *display, const Mode *mode) {
+    Mode *temp_modes = realloc(display->modes, (display->mode_count + 1) * sizeof(Mode));
+    if (temp_modes == NULL) {
+        perror("Failed to reallocate memory for modes");
+        return false;
+    }
+    display->modes = temp_modes;
+    display->modes[display->mode_count++] = *mode;
+    return true;
+}
+
+static bool push_rate(Mode *mode, const RefreshRate *rate) {
+    RefreshRate *temp_rates = realloc(mode->refresh_rates, (mode->rate_count + 1) * sizeof(RefreshRate));
+    if (temp_rates == NULL) {
+        perror("Failed to reallocate memory for refresh rates");
+        return false;
+    }
+    mode->refresh_rates = temp_rates;
+    mode->refresh_rates[mode->rate_count++] = *rate;
+    return true;
+}
+
+/**
+ * @brief Phase two of parsing: decodes a display's mode list if that hasn't happened yet.
+ * Cheap to call repeatedly; anything that walks display->modes should call it first.
+ * Verbose modelines with the same name are grouped into one Mode, like the terse listing does.
+ * @param display The display whose modes are needed.
+ * @return True on success, false if memory ran out.
+ */
+bool display_ensure_modes(Display *display) {
+    if (display->mode_text == NULL) return true;
+
+    char last_name[32] = ""; // Name of the last verbose modeline
+    bool ok = true;
+    char *line = display->mode_text;
+    while (ok && *line) {
+        char *next = strchr(line, '\n');
+        if (next) *next = '\0';
+
+        Mode *last = display->mode_count > 0 ? &display->modes[display->mode_count - 1] : NULL;
+        RefreshRate rate;
+        char name[32];
+        Mode mode;
+        int verbose = decode_verbose_mode_line(line, name, sizeof(name), &rate);
+        if (verbose < 0) {
+            last_name[0] = '\0'; // Skipped, and so are its h:/v: lines
+        } else if (verbose > 0) {
+            if (last == NULL || strcmp(name, last_name) != 0) {
+                memset(&mode, 0, sizeof(Mode));
+                snprintf(mode.name, sizeof(mode.name), "%s", name);
+                decode_mode_name(&mode);
+                ok = push_mode(display, &mode);
+                last = &display->modes[display->mode_count - 1];
+                snprintf(last_name, sizeof(last_name), "%s", name);
+            }
+            ok = ok && push_rate(last, &rate);
+            // The modeline flags are the authority on scan type, whatever the name says
+            if (ok && strstr(rate.timing.flags, "Interlace")) last->interlaced = 1;
+            if (ok && strstr(rate.timing.flags, "DoubleScan")) last->doublescan = 1;
+        } else if (last && last->rate_count > 0 && last_name[0] != '\0' &&
+                   decode_timing_line(line, &last->refresh_rates[last->rate_count - 1])) {
+            // Filled in the timing of the last modeline; a custom name gets its size from it
+            const ModeTiming *t = &last->refresh_rates[last->rate_count - 1].timing;
+            if (last->width == 0) last->width = t->h_display;
+            if (last->height == 0) last->height = t->v_display;
+        } else {
+            int terse = decode_mode_line(line, &mode);
+            if (terse > 0) {
+                ok = push_mode(display, &mode);
+                if (!ok) free(mode.refresh_rates);
+            }
+            if (terse != 0) last_name[0] = '\0';
+        }
+
+        if (next == NULL) break;
+        line = next + 1;
+    }
+    if (!ok) return false;
+
+    free(display->mode_text);
+    display->mode_text = NULL;
+    display->mode_text_len = 0;
+    return true;
+}
+
+/**
+ * @brief Checks whether a mode goes by the given name. A plain "WxH" also matches
+ * a custom-named mode of that size, but never an interlaced or doublescan one.
+ */
+static bool mode_matches(const Mode *m, const char *mode_name) {
+    if (strcmp(m->name, mode_name) == 0) return true;
+
+    int w, h;
+    char extra;
+    if (m->interlaced || m->doublescan || sscanf(mode_name, "%dx%d%c", &w, &h, &extra) != 2) return false;
+    return m->width == w && m->height == h;
+}
+
+/**
+ * @brief Finds the advertised rate closest to the one asked for, in the mode with the given name.
+ * With verbose output this picks one exact modeline, whose XID can then be applied directly.
+ * Exact name matches win over size matches, so "1920x1080" never lands on "1920x1080i".
+ * @param display The display; decode its modes first.
+ * @param mode_name Mode name, e.g. "1920x1080", "1920x1080i" or "my-mode".
+ * @param rate Wanted rate in Hz, or 0 for the preferred (else first) rate of the mode.
+ * @param mode If not NULL, filled with the mode the rate belongs to.
+ * @return The rate, or NULL if the display has no such mode.
+ */
+const RefreshRate* display_find_rate(const Display *display, const char *mode_name, double rate, const Mode **mode) {
+    const RefreshRate *best = NULL;
+    double best_diff = 0.0;
+    bool best_exact = false;
+    for (int i = 0; i < display->mode_count; i++) {
+        const Mode *m = &display->modes[i];
+        if (!mode_matches(m, mode_name)) continue;
+        bool exact = strcmp(m->name, mode_name) == 0;
+        if (best_exact && !exact) continue;
+        for (int j = 0; j < m->rate_count; j++) {
+            const RefreshRate *r = &m->refresh_rates[j];
+            double diff = r->rate - rate;
+            if (diff < 0) diff = -diff;
+            if (rate <= 0.0) diff = r->is_preferred ? 0.0 : 1.0;
+            if (best == NULL || (exact && !best_exact) || diff < best_diff) {
+                best = r;
+                best_diff = diff;
+                best_exact = exact;
+                if (mode) *mode = m;
+            }
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Cuts trailing whitespace off a string in place.
+ */
+static char* trim_end(char *str) {
+    size_t len = strlen(str);
+    while (len > 0 && isspace((unsigned char)str[len - 1])) str[--len] = '\0';
+    return str;
+}
+
+/**
+ * @brief How many of the output's own pixels there are per inch, across its width.
+ * The header line gives the physical size the way the output is rotated, and the current
+ * size is scaled, so the scale is taken back out.
+ * @return The DPI, or 0 if the output is off or its physical size isn't known.
+ */
+double display_dpi(const Display *display) {
+    if (!display->is_active || display->width <= 0 || display->width_mm <= 0) return 0.0;
+    double scale = display->scale > 0.0 ? display->scale : 1.0;
+    // A tile reports the size of the whole monitor. Turned sideways, the monitor's rows of
+    // tiles are what lie side by side across its width.
+    int width = display->width;
+    if (display->tile_group != 0) {
+        width *= rotation_is_sideways(display->rotation) ? display->tile_rows : display->tile_columns;
+    }
+    return width / scale / (display->width_mm / 25.4);
+}
+
+/**
+ * @brief The tile that stands for a whole tiled monitor: the top-left one of its group.
+ * Lists show only that one, and placing or moding it places and modes the whole monitor.
+ * @return The leader, or the display itself if it isn't a tile or the top-left tile isn't connected.
+ */
+const Display* display_tile_leader(const Display *displays, int count, const Display *display) {
+    if (display->tile_group == 0) return display;
+    for (int i = 0; i < count; i++) {
+        const Display *d = &displays[i];
+        if (d->connected && d->tile_group == display->tile_group && d->tile_column == 0 && d->tile_row == 0) {
+            return d;
+        }
+    }
+    return display;
+}
+
+/**
+ * @brief True for the tiles that follow their group's leader rather than being handled on their own.
+ */
+bool display_is_tile_follower(const Display *displays, int count, const Display *display) {
+    return display_tile_leader(displays, count, display) != display;
+}
+
+/**
+ * @brief Decodes the raw property block kept by the first pass, the first time anyone asks.
+ * Splits the block in place, so the strings point into display->property_text.
+ * @return True on success, false if memory ran out.
+ */
+bool display_ensure_properties(Display *display) {
+    if (display->properties_parsed) return true;
+
+    char *line = display->property_text;
+    while (line && *line) {
+        char *next = strchr(line, '\n');
+        if (next) *next = '\0';
+
+        if (line[0] == '\t' && line[1] != '\0' && !isspace((unsigned char)line[1])) {
+            // A new property: "\tName: value"
+            OutputProperty *temp = realloc(display->properties, (display->property_count + 1) * sizeof(OutputProperty));
+            if (temp == NULL) {
+                perror("Failed to reallocate memory for properties");
+                return false;
+            }
+            display->properties = temp;
+            OutputProperty *prop = &display->properties[display->property_count++];
+            char *colon = strchr(line, ':');
+            if (colon) *colon = '\0';
+            snprintf(prop->name, sizeof(prop->name), "%s", trim_end(line + 1));
+            if (colon) {
+                char *value = colon + 1;
+                while (isspace((unsigned char)*value)) value++;
+                prop->value = trim_end(value);
             } else {
-                current_display_ptr->connected = 0;
-                sscanf(line, "%s disconnected", current_display_ptr->name);
-                continue; // Nothing more to parse for a disconnected display
-            }
-
-            // Do a more robust parser later
-            if (strstr(line, " primary")) {
-                current_display_ptr->is_primary = 1;
-                sscanf(line, "%s connected primary %dx%d+%d+%d",
-                       current_display_ptr->name,
-                       &current_display_ptr->width, &current_display_ptr->height,
-                       &current_display_ptr->x_offset, &current_display_ptr->y_offset);
+                prop->value = line + strlen(line);
+            }
+            prop->details = prop->value + strlen(prop->value); // Empty until an indented line shows up
+        } else if (display->property_count > 0) {
+            // An indented line belongs to the property above it
+            OutputProperty *prop = &display->properties[display->property_count - 1];
+            while (isspace((unsigned char)*line)) line++;
+            if (prop->details[0] == '\0') {
+                prop->details = line;
             } else {
-                current_display_ptr->is_primary = 0;
-                sscanf(line, "%s connected %dx%d+%d+%d",
-                       current_display_ptr->name,
-                       &current_display_ptr->width, &current_display_ptr->height,
-                       &current_display_ptr->x_offset, &current_display_ptr->y_offset);
-            }
-
-        } else if (current_display_ptr && current_display_ptr->connected && isspace(line[0])) {
-            // Pvz: "   1920x1080     60.01*+  59.97    59.96    59.93  "
-            int w, h, n;
-            // Use " %dx%d" to skip leading whitespace and %n to find where the resolution part ends.
-            if (sscanf(line, " %dx%d %n", &w, &h, &n) == 2) {
-                // new mode was found, add it to the current display
-                current_display_ptr->mode_count++;
-                Mode *temp_modes = realloc(current_display_ptr->modes, current_display_ptr->mode_count * sizeof(Mode));
-                if (temp_modes == NULL) { /* Handle error */ exit(1); }
-                current_display_ptr->modes = temp_modes;
-
-                Mode *current_mode = &current_display_ptr->modes[current_display_ptr->mode_count - 1];
-                memset(current_mode, 0, sizeof(Mode));
-                current_mode->width = w;
-                current_mode->height = h;
-
-                char *ptr = &line[n]; // Start parsing for refresh rates from here
-                char *endptr;
-
-                // Loop through the rest of the line to find all refresh rates
-                while (1) {
-                    // strtod converts string to double, skipping leading whitespace,
-                    // and updates endptr to point after the parsed number.
-                    double rate_val = strtod(ptr, &endptr);
-
-                    // If no conversion was made, we've reached the end of the numbers.
-                    if (ptr == endptr) {
-                        break;
-                    }
-
-                    // A new refresh rate was found, add it to the current mode
-                    current_mode->rate_count++;
-                    RefreshRate *temp_rates = realloc(current_mode->refresh_rates, current_mode->rate_count * sizeof(RefreshRate));
-                    if (temp_rates == NULL) { /* Handle error later */ exit(1); }
-                    current_mode->refresh_rates = temp_rates;
-
-                    RefreshRate *current_rate = &current_mode->refresh_rates[current_mode->rate_count - 1];
-                    memset(current_rate, 0, sizeof(RefreshRate));
-                    current_rate->rate = rate_val;
-
-                    ptr = endptr; // ptr now points to potential markers like '*' or '+'
-
-                    // accounting for variable whitespace and handle the '+' '*' 
-                    while (1) {
-                        // Skip any whitespace between the number and a potential marker.
-                        while (*ptr && isspace((unsigned char)*ptr)) {
-                            ptr++;
-                        }
-
-                        if (*ptr == '*') {
-                            current_rate->is_current = 1;
-                            ptr++; // Consume the marker
-                        } else if (*ptr == '+') {
-                            current_rate->is_preferred = 1;
-                            ptr++; // Consume the marker
-                        } else {
-                            // break the marker-parsing loop
-                            break;
-                        }
-                    }
-                }
+                // Join with the previous detail line (trimming may have left a gap)
+                char *end = prop->details + strlen(prop->details);
+                *end++ = '\n';
+                memmove(end, line, strlen(line) + 1);
+                line = end;
             }
+            trim_end(line);
+        }
+
+        if (next == NULL) break;
+        line = next + 1;
+    }
+
+    display->properties_parsed = 1;
+    return true;
+}
+
+/**
+ * @brief Looks up one output property by name, decoding the properties if needed.
+ * @return The property, or NULL if the output doesn't have it (or this wasn't verbose output).
+ */
+const OutputProperty* display_find_property(Display *display, const char *name) {
+    if (!display_ensure_properties(display)) return NULL;
+    for (int i = 0; i < display->property_count; i++) {
+        if (strcmp(display->properties[i].name, name) == 0) return &display->properties[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Decodes the mode lists of every display in an array.
+ * @return True on success, false if memory ran out.
+ */
+bool displays_ensure_modes(Display *displays, int count) {
+    for (int i = 0; i < count; i++) {
+        if (!display_ensure_modes(&displays[i])) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Sets up an empty push parser.
+ */
+void xrandr_parser_init(XrandrParser *parser) {
+    memset(parser, 0, sizeof(XrandrParser));
+    parser->current = -1;
+}
+
+/**
+ * @brief Releases everything the parser holds, including outputs nobody took.
+ */
+void xrandr_parser_free(XrandrParser *parser) {
+    free_displays(parser->displays, parser->display_count);
+    free(parser->line);
+    xrandr_parser_init(parser);
+}
+
+static const char *rotation_names[] = {"normal", "left", "inverted", "right"};
+static const char *reflection_names[] = {"normal", "x", "y", "xy"};
+
+/**
+ * @brief True for left and right, where the output's width and height trade places.
+ */
+bool rotation_is_sideways(unsigned int rotation) {
+    return (rotation & (ROTATION_LEFT | ROTATION_RIGHT)) != 0;
+}
+
+/**
+ * @brief The --rotate name for a rotation, e.g. "left".
+ */
+const char* rotation_name(unsigned int rotation) {
+    for (int i = 0; i < 4; i++) {
+        if (rotation & (ROTATION_NORMAL << i)) return rotation_names[i];
+    }
+    return rotation_names[0];
+}
+
+/**
+ * @brief The --reflect name for the reflection bits of a rotation: normal, x, y or xy.
+ */
+const char* reflection_name(unsigned int rotation) {
+    return reflection_names[(rotation & REFLECT_MASK) >> 4];
+}
+
+/**
+ * @brief Replaces the rotation in *rotation by the one --rotate calls name, keeping the reflection.
+ * @return False if there is no such rotation.
+ */
+bool rotation_from_name(const char *name, unsigned int *rotation) {
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, rotation_names[i]) == 0) {
+            *rotation = (*rotation & REFLECT_MASK) | (ROTATION_NORMAL << i);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Replaces the reflection in *rotation by the one --reflect calls name, keeping the rotation.
+ * @return False if there is no such reflection.
+ */
+bool reflection_from_name(const char *name, unsigned int *rotation) {
+    for (unsigned int i = 0; i < 4; i++) {
+        if (strcmp(name, reflection_names[i]) == 0) {
+            *rotation = (*rotation & ROTATION_MASK) | (i << 4);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Reads the rotation out of an output's header line, e.g.
+ * "HDMI-1 connected 1080x1920+0+0 (0x4b) left X axis (normal left inverted right x axis y axis) ...".
+ * The current one comes before the parenthesised list of supported ones; xrandr writes the
+ * current reflection as "X axis", "Y axis" or "X and Y axis", and the supported ones in lower case.
+ */
+static void parse_rotation(const char *line, Display *d) {
+    const char *list = strstr(line, "(normal");
+    d->rotation = ROTATION_NORMAL;
+    d->rotations = 0;
+    if (list == NULL) return;
+
+    char word[32];
+    int used;
+    for (const char *p = line; p < list && sscanf(p, "%31s%n", word, &used) == 1; p += used) {
+        if (strcmp(word, "X") == 0) d->rotation |= REFLECT_X;
+        else if (strcmp(word, "Y") == 0) d->rotation |= REFLECT_Y;
+        else rotation_from_name(word, &d->rotation);
+    }
+    const char *end = strchr(list, ')');
+    for (const char *p = list + 1; end && p < end && sscanf(p, "%31[^ )]%n", word, &used) == 1; p += used) {
+        unsigned int bits = 0;
+        if (strcmp(word, "x") == 0) d->rotations |= REFLECT_X;
+        else if (strcmp(word, "y") == 0) d->rotations |= REFLECT_Y;
+        else if (rotation_from_name(word, &bits)) d->rotations |= bits;
+        while (*(p + used) == ' ') used++;
+    }
+}
+
+/**
+ * @brief Reads the TILE property, eight numbers: group id, flags, tiles across, tiles down,
+ * this tile's column and row, and the tile width and height. Depending on the xrandr version
+ * they're separated by spaces or commas. Anything that doesn't add up leaves the output untiled.
+ */
+static void parse_tile(const char *value, Display *d) {
+    int v[8];
+    int n = 0;
+    for (const char *p = value; *p && n < 8; ) {
+        char *end;
+        long number = strtol(p, &end, 10);
+        if (end == p) {
+            p++;
+            continue;
+        }
+        v[n++] = (int)number;
+        p = end;
+    }
+    if (n < 8 || v[0] <= 0 || v[2] <= 0 || v[3] <= 0 || v[4] < 0 || v[4] >= v[2] ||
+        v[5] < 0 || v[5] >= v[3] || v[6] <= 0 || v[7] <= 0) {
+        return;
+    }
+    d->tile_group = v[0];
+    d->tile_columns = v[2];
+    d->tile_rows = v[3];
+    d->tile_column = v[4];
+    d->tile_row = v[5];
+    d->tile_width = v[6];
+    d->tile_height = v[7];
+}
+
+/**
+ * @brief Handles one complete line of xrandr output.
+ * @return False if memory ran out.
+ */
+static bool parse_line(XrandrParser *parser, const char *line) {
+    // Check for lines that describe a display connection
+    if (!isspace((unsigned char)line[0]) && strstr(line, " connected")) {
+        Display *temp_displays = realloc(parser->displays, (parser->display_count + 1) * sizeof(Display));
+        if (temp_displays == NULL) {
+            perror("Failed to reallocate memory for displays");
+            return false;
+        }
+        parser->displays = temp_displays;
+        parser->current = parser->display_count++;
+        parser->in_edid = false;
+        parser->current_pending = false;
+        Display *current_display_ptr = &parser->displays[parser->current];
+        memset(current_display_ptr, 0, sizeof(Display));
+        current_display_ptr->mode_signature = FNV1A_64_INIT;
+        current_display_ptr->crtc = -1;
+        current_display_ptr->scale = 1.0;
+        current_display_ptr->connected = 1;
+
+        int matches = 0;
+        if (strstr(line, " primary")) {
+            current_display_ptr->is_primary = 1;
+            matches = sscanf(line, "%31s connected primary %dx%d+%d+%d",
+                   current_display_ptr->name,
+                   &current_display_ptr->width, &current_display_ptr->height,
+                   &current_display_ptr->x_offset, &current_display_ptr->y_offset);
         } else {
-            // It could be the "Screen 0: ..." line or a blank line or smth else
-            current_display_ptr = NULL;
+            current_display_ptr->is_primary = 0;
+            matches = sscanf(line, "%31s connected %dx%d+%d+%d",
+                   current_display_ptr->name,
+                   &current_display_ptr->width, &current_display_ptr->height,
+                   &current_display_ptr->x_offset, &current_display_ptr->y_offset);
+        }
+        if (matches == 5) { // 1 for name, 4 for geometry
+            current_display_ptr->is_active = 1;
+        } else {
+            current_display_ptr->is_active = 0;
+            // If geometry parsing failed, at least get the name
+            sscanf(line, "%31s", current_display_ptr->name);
+        }
+        parse_rotation(line, current_display_ptr);
+        // The physical size comes last, after the list of rotations: "... y axis) 309mm x 174mm"
+        const char *after_list = strrchr(line, ')');
+        if (after_list == NULL || sscanf(after_list + 1, "%dmm x %dmm", &current_display_ptr->width_mm,
+                                         &current_display_ptr->height_mm) != 2) {
+            current_display_ptr->width_mm = current_display_ptr->height_mm = 0;
+        }
+    } else if (parser->current >= 0 && line[0] == '\t') {
+        // Verbose output: properties and EDID hex are indented with tabs, modes with spaces
+        Display *d = &parser->displays[parser->current];
+        if (parser->in_edid && is_edid_line(line)) {
+            return append_edid_line(d, line);
         }
+        parser->in_edid = strncmp(line, "\tEDID:", 6) == 0;
+        // The CRTC lines are wanted for every apply, so they're picked out right away
+        if (strncmp(line, "\tCRTC:", 6) == 0) {
+            sscanf(line + 6, "%d", &d->crtc);
+        } else if (strncmp(line, "\tTransform:", 11) == 0) {
+            // Only the first row is on this line; a --scale shows up as its first entry
+            if (sscanf(line + 11, "%lf", &d->scale) != 1 || d->scale <= 0.0) d->scale = 1.0;
+        } else if (strncmp(line, "\tPanning:", 9) == 0) {
+            if (sscanf(line + 9, "%dx%d+%d+%d", &d->panning_width, &d->panning_height,
+                       &d->panning_x, &d->panning_y) != 4 || d->panning_width <= 0 || d->panning_height <= 0) {
+                d->panning_width = d->panning_height = d->panning_x = d->panning_y = 0;
+            }
+        } else if (strncmp(line, "\tTILE:", 6) == 0) {
+            parse_tile(line + 6, d);
+        } else if (strncmp(line, "\tCRTCs:", 7) == 0) {
+            const char *ptr = line + 7;
+            int index, used;
+            while (sscanf(ptr, "%d%n", &index, &used) == 1) {
+                if (index >= 0 && index < 32) d->possible_crtcs |= (uint32_t)1 << index;
+                ptr += used;
+            }
+        }
+        if (!parser->in_edid && !append_text(&d->property_text, &d->property_text_len, line)) {
+            return false;
+        }
+    } else if (parser->current >= 0 && isspace((unsigned char)line[0])) {
+        // Phase one: just remember the mode line, display_ensure_modes() decodes it later
+        parser->in_edid = false;
+        if (!append_mode_line(parser, &parser->displays[parser->current], line)) {
+            return false;
+        }
+    } else {
+        // It could be the "Screen 0: ..." line or a blank line or smth else
+        ScreenInfo *s = &parser->screen;
+        if (s->max_width == 0) {
+            sscanf(line, "Screen %*d: minimum %d x %d, current %d x %d, maximum %d x %d",
+                   &s->min_width, &s->min_height, &s->width, &s->height, &s->max_width, &s->max_height);
+        }
+        parser->current = -1;
+        parser->in_edid = false;
+        parser->current_pending = false;
     }
 
-    pclose(fp);
+    // Whatever is before the output still receiving mode lines is done.
+    parser->complete_count = parser->current >= 0 ? parser->current : parser->display_count;
+    return true;
+}
+
+/**
+ * @brief Feeds the next chunk of xrandr output. Chunks can end anywhere, even mid-line;
+ * the leftover is kept until the rest of the line arrives.
+ * After each call, the first complete_count outputs are fully parsed.
+ * Note that feeding may move parser->displays, so don't keep pointers into it across calls.
+ * @param parser The parser.
+ * @param data The bytes that just arrived.
+ * @param len How many there are.
+ * @return True on success, false if memory ran out (the parser is then unusable).
+ */
+bool xrandr_parser_feed(XrandrParser *parser, const char *data, size_t len) {
+    if (parser->failed) return false;
+
+    while (len > 0) {
+        const char *newline = memchr(data, '\n', len);
+        size_t take = newline ? (size_t)(newline - data) + 1 : len;
+
+        if (parser->line_len + take + 1 > parser->line_capacity) {
+            size_t new_capacity = parser->line_capacity ? parser->line_capacity : 256;
+            while (new_capacity < parser->line_len + take + 1) new_capacity *= 2;
+            char *temp = realloc(parser->line, new_capacity);
+            if (temp == NULL) {
+                perror("Failed to reallocate memory for xrandr line");
+                parser->failed = true;
+                return false;
+            }
+            parser->line = temp;
+            parser->line_capacity = new_capacity;
+        }
+        memcpy(parser->line + parser->line_len, data, take);
+        parser->line_len += take;
+        parser->line[parser->line_len] = '\0';
+        data += take;
+        len -= take;
+
+        if (newline) {
+            parser->line_len = 0;
+            if (!parse_line(parser, parser->line)) {
+                parser->failed = true;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Ends the input: parses a last unterminated line and hands over the outputs.
+ * The parser is reset afterwards and can be reused or freed.
+ * @param display_count Filled with the number of displays found.
+ * @param screen If not NULL, filled with the screen's framebuffer limits.
+ * @return Same as parse_xrandr_output().
+ */
+Display* xrandr_parser_finish(XrandrParser *parser, int *display_count, ScreenInfo *screen) {
+    *display_count = 0;
+    if (screen) memset(screen, 0, sizeof(ScreenInfo));
+    if (!parser->failed && parser->line_len > 0) {
+        parser->line_len = 0;
+        parser->failed = !parse_line(parser, parser->line);
+    }
+    if (parser->failed) {
+        xrandr_parser_free(parser);
+        return NULL;
+    }
+
+    Display *displays = parser->displays;
+    *display_count = parser->display_count;
+    if (screen) {
+        *screen = parser->screen;
+        // The union of the lists is every CRTC the connected outputs could use
+        for (int i = 0; i < parser->display_count; i++) screen->crtcs |= displays[i].possible_crtcs;
+    }
+    parser->displays = NULL;
+    parser->display_count = 0;
+    xrandr_parser_free(parser);
     return displays;
 }
+
+/**
+ * @brief Parses xrandr output from any stream.
+ * @param fp The stream to read, e.g. a pipe from popen().
+ * @param display_count Filled with the number of displays found.
+ * @param screen If not NULL, filled with the screen's framebuffer limits.
+ * @return Same as parse_xrandr_output().
+ */
+Display* parse_xrandr_stream(FILE *fp, int *display_count, ScreenInfo *screen) {
+    XrandrParser parser;
+    xrandr_parser_init(&parser);
+
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        if (!xrandr_parser_feed(&parser, chunk, n)) break;
+    }
+    return xrandr_parser_finish(&parser, display_count, screen);
+}
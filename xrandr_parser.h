@@ -1,6 +1,39 @@
 #ifndef XRANDR_PARSER_H
 #define XRANDR_PARSER_H
 
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Queries that need CRTC lists, EDIDs, properties or transforms ask for --verbose. The plain
+// listing is much cheaper for xrandr to print and us to parse, so the rest go without.
+#define XRANDR_VERBOSE_ARG "--verbose"
+
+/**
+ * @brief Full modeline timings. Only `xrandr --verbose` prints these.
+ */
+typedef struct {
+    unsigned long id;   // Mode XID, e.g. 0x47
+    double pixel_clock; // MHz
+    int h_display, h_sync_start, h_sync_end, h_total, h_skew;
+    int v_display, v_sync_start, v_sync_end, v_total;
+    char flags[48];     // e.g. "+HSync -VSync"
+    // Exact refresh rate in Hz, rate_num / rate_den (0/0 if the timing is incomplete)
+    uint64_t rate_num;
+    uint64_t rate_den;
+} ModeTiming;
+
+// Rotation and reflection bits, the same values RandR itself uses
+#define ROTATION_NORMAL   0x01
+#define ROTATION_LEFT     0x02
+#define ROTATION_INVERTED 0x04
+#define ROTATION_RIGHT    0x08
+#define ROTATION_MASK     0x0f
+#define REFLECT_X         0x10
+#define REFLECT_Y         0x20
+#define REFLECT_MASK      0x30
+
 /**
  * @brief Holds information about a specific refresh rate for a mode.
  */
@@ -8,18 +41,43 @@ typedef struct {
     double rate;
     int is_current;   // Marked with '*'
     int is_preferred; // Marked with '+'
+    int has_timing;   // Set if timing was parsed (verbose output only)
+    ModeTiming timing;
 } RefreshRate;
 
 /**
  * @brief Holds information about a display mode (resolution).
  */
 typedef struct {
-    int width;
+    char name[32];  // Mode name as xrandr lists it, e.g. "1920x1080", "1920x1080i" or "my-mode"
+    int width;      // 0x0 for a custom name until its timing is known
     int height;
+    int interlaced;
+    int doublescan;
     RefreshRate *refresh_rates;
     int rate_count;
 } Mode;
 
+/**
+ * @brief One output property from `xrandr --verbose`, e.g. "Broadcast RGB".
+ */
+typedef struct {
+    char name[48];
+    char *value;   // Text after the colon
+    char *details; // Lines below it ("supported: ...", matrix rows), "" if none
+} OutputProperty;
+
+/**
+ * @brief Framebuffer limits from the "Screen 0: minimum ..., current ..., maximum ..." line,
+ * and the CRTCs the outputs mentioned. All zero if not seen.
+ */
+typedef struct {
+    int min_width, min_height;
+    int width, height;
+    int max_width, max_height;
+    uint32_t crtcs; // Bit i set for CRTC i (from the verbose "CRTCs:" lines, 0 for the plain listing)
+} ScreenInfo;
+
 /**
  * @brief Holds all information about a single display output.
  */
@@ -33,12 +91,87 @@ typedef struct {
     int height;
     int x_offset;
     int y_offset;
-    // List of available modes
+    double current_rate; // The '*' rate, known even before the modes are decoded
+    unsigned int rotation;  // One ROTATION_* bit plus REFLECT_* bits; width/height are already rotated
+    unsigned int rotations; // Every ROTATION_*/REFLECT_* bit the output supports
+    double scale;           // Screen pixels per mode pixel, from the verbose "Transform:" (1 if unscaled)
+    int width_mm;           // Physical size from the header line, as rotated; 0 if unknown
+    int height_mm;
+    char mode_name[32];  // Name of the current mode, likewise ("" if off)
+    // Panning area (verbose "Panning:" line): the part of the screen the output scrolls over,
+    // all zero if it doesn't pan
+    int panning_width, panning_height;
+    int panning_x, panning_y;
+    // Tile (verbose "TILE" property): big monitors, often on MST, show up as one output per tile.
+    // Outputs with the same tile_group are one monitor; tile_group is 0 if the output isn't a tile.
+    int tile_group;
+    int tile_columns, tile_rows; // Tiles across and down the whole monitor
+    int tile_column, tile_row;   // Where this one sits, from 0
+    int tile_width, tile_height; // Size of one tile in pixels
+    // List of available modes. Empty until display_ensure_modes() decodes mode_text.
     Mode *modes;
     int mode_count;
+    // Raw mode lines kept by the first parsing pass, NULL once decoded
+    char *mode_text;
+    size_t mode_text_len;
+    uint64_t mode_signature; // Hash of the mode list, ignoring which rate is current
+    // CRTCs (verbose output only): the one driving the output and the ones that could
+    int crtc;                // -1 if none
+    uint32_t possible_crtcs; // Bit i set if CRTC i can drive this output
+    // Raw EDID bytes (verbose output only, NULL otherwise)
+    unsigned char *edid;
+    size_t edid_len;
+    // Properties, kept as raw text until display_ensure_properties() is called
+    char *property_text;
+    size_t property_text_len;
+    OutputProperty *properties;
+    int property_count;
+    int properties_parsed;
 } Display;
 
-Display* parse_xrandr_output(int *display_count);
+/**
+ * @brief Resumable push parser: feed it xrandr output in chunks of any size,
+ * e.g. straight from a non-blocking pipe, and outputs become usable as they complete.
+ */
+typedef struct {
+    Display *displays;
+    int display_count;  // Outputs seen so far; the last may still be getting mode lines
+    int complete_count; // Outputs that are fully parsed
+    int current;        // Output receiving mode lines, -1 if none
+    char *line;         // Partial line carried over between chunks
+    size_t line_len;
+    size_t line_capacity;
+    bool in_edid;         // The lines that follow are EDID hex
+    bool current_pending; // The current mode was seen; its refresh rate is on the "v:" line
+    RefreshRate pending_rate; // The current modeline, until its "v:" line shows up
+    bool failed;
+    ScreenInfo screen;
+} XrandrParser;
+
+void xrandr_parser_init(XrandrParser *parser);
+bool xrandr_parser_feed(XrandrParser *parser, const char *data, size_t len);
+Display* xrandr_parser_finish(XrandrParser *parser, int *display_count, ScreenInfo *screen);
+void xrandr_parser_free(XrandrParser *parser);
+
+Display* parse_xrandr_output(int *display_count, ScreenInfo *screen, bool verbose);
+Display* parse_xrandr_stream(FILE *fp, int *display_count, ScreenInfo *screen);
+Display* parse_xrandr_text(const char *text, size_t len, int *display_count, ScreenInfo *screen);
+char* read_xrandr_output(size_t *len, bool verbose);
 void free_displays(Display *displays, int count);
+bool display_ensure_modes(Display *display);
+bool displays_ensure_modes(Display *displays, int count);
+const RefreshRate* display_find_rate(const Display *display, const char *mode_name, double rate, const Mode **mode);
+bool display_ensure_properties(Display *display);
+const OutputProperty* display_find_property(Display *display, const char *name);
+double display_dpi(const Display *display);
+const Display* display_tile_leader(const Display *displays, int count, const Display *display);
+bool display_is_tile_follower(const Display *displays, int count, const Display *display);
+bool rotation_is_sideways(unsigned int rotation);
+const char* rotation_name(unsigned int rotation);
+const char* reflection_name(unsigned int rotation);
+bool rotation_from_name(const char *name, unsigned int *rotation);
+bool reflection_from_name(const char *name, unsigned int *rotation);
+void print_displays(Display *displays, int count);
+void fprint_displays(FILE *out, Display *displays, int count);
 
 #endif // XRANDR_PARSER_H
\ No newline at end of file
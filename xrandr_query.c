@@ -0,0 +1,103 @@
+// Needed for fork(), pipe() and friends under -std=c99.
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "xrandr_query.h"
+
+/**
+ * @brief Starts xrandr in the background. Its output is picked up with xrandr_query_read().
+ * @return True on success, false on failure.
+ */
+bool xrandr_query_start(XrandrQuery *q) {
+    memset(q, 0, sizeof(XrandrQuery));
+    q->fd = -1;
+    xrandr_parser_init(&q->parser);
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("Failed to create pipe for xrandr");
+        return false;
+    }
+
+    q->pid = fork();
+    if (q->pid < 0) {
+        perror("Failed to run xrandr command");
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (q->pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execlp("xrandr", "xrandr", XRANDR_VERBOSE_ARG, (char *)NULL);
+        _exit(127);
+    }
+
+    close(fds[1]);
+    q->fd = fds[0];
+    fcntl(q->fd, F_SETFL, fcntl(q->fd, F_GETFL) | O_NONBLOCK);
+    fcntl(q->fd, F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+/**
+ * @brief Reads and parses whatever output is available right now.
+ * @return 1 once xrandr has closed its output, 0 if more is coming, -1 on failure.
+ */
+int xrandr_query_read(XrandrQuery *q) {
+    if (q->fd < 0) return 1;
+
+    char chunk[4096];
+    while (1) {
+        ssize_t n = read(q->fd, chunk, sizeof(chunk));
+        if (n > 0) {
+            if (!xrandr_parser_feed(&q->parser, chunk, n)) return -1;
+            continue;
+        }
+        if (n == 0) {
+            close(q->fd);
+            q->fd = -1;
+            return 1;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        return -1;
+    }
+}
+
+/**
+ * @brief Waits for the rest of the output and reaps the child.
+ * @param display_count Filled with the number of displays found.
+ * @param screen If not NULL, filled with the screen's framebuffer limits.
+ * @return The parsed displays (free with free_displays()), or NULL if xrandr failed.
+ */
+Display* xrandr_query_finish(XrandrQuery *q, int *display_count, ScreenInfo *screen) {
+    int rc = 0;
+    while ((rc = xrandr_query_read(q)) == 0) {
+        struct pollfd pfd = {q->fd, POLLIN, 0};
+        poll(&pfd, 1, -1);
+    }
+    if (q->fd >= 0) close(q->fd);
+
+    int status = 0;
+    while (waitpid(q->pid, &status, 0) < 0 && errno == EINTR) {
+    }
+
+    Display *displays = xrandr_parser_finish(&q->parser, display_count, screen);
+    if (rc < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        free_displays(displays, *display_count);
+        displays = NULL;
+        *display_count = 0;
+    }
+    memset(q, 0, sizeof(XrandrQuery));
+    q->fd = -1;
+    return displays;
+}
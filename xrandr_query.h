@@ -0,0 +1,22 @@
+#ifndef XRANDR_QUERY_H
+#define XRANDR_QUERY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "xrandr_parser.h"
+
+/**
+ * @brief An xrandr child process whose output is parsed as it arrives, without blocking.
+ */
+typedef struct {
+    pid_t pid;
+    int fd;              // Read end of the pipe, non-blocking (-1 once closed)
+    XrandrParser parser; // parser.complete_count outputs are already usable
+} XrandrQuery;
+
+bool xrandr_query_start(XrandrQuery *q);
+int xrandr_query_read(XrandrQuery *q);
+Display* xrandr_query_finish(XrandrQuery *q, int *display_count, ScreenInfo *screen);
+
+#endif // XRANDR_QUERY_H